@@ -0,0 +1,200 @@
+#include "ai.h"
+
+
+static ai_config_t g_config;
+static int16_t g_screen_h;
+static pong_vel_t g_last_vel;
+static bool g_have_vel;
+static uint32_t g_rng;
+static ai_paddle_t g_left;
+static ai_paddle_t g_right;
+static ai_stats_t g_stats;
+
+
+// Ticks needed to cover num pixels at d pixels per tick, at least one
+static int32_t ticks_to_cover(int32_t num, int32_t d)
+{
+    int32_t t = (num + d - 1) / d;
+    return (num <= 0 || t < 1) ? 1 : t;
+}
+
+static int16_t fold_y(int32_t y, int32_t dy, int32_t t, int16_t *dy_out)
+{
+    const int32_t range = g_screen_h - BALL_SIZE;   // highest ball y
+    const int32_t d = dy > 0 ? dy : -dy;
+
+    if(dy == 0)
+    {
+        *dy_out = 0;
+        return (int16_t)y;
+    }
+
+    // First wall: the ball is clamped onto it on the tick it gets there
+    int32_t first = dy > 0 ? ticks_to_cover(range - y, d) : ticks_to_cover(y, d);
+    if(t < first)
+    {
+        *dy_out = (int16_t)dy;
+        return (int16_t)(y + dy * t);
+    }
+
+    // From then on it leaves one wall and reaches the other every
+    // ceil(range / d) ticks
+    int32_t period = ticks_to_cover(range, d);
+    int32_t after = t - first;
+    bool at_bottom = (dy > 0) != (((after / period) & 1) != 0);
+    int32_t travel = d * (after % period);
+
+    *dy_out = (int16_t)(at_bottom ? -d : d);
+    return (int16_t)(at_bottom ? range - travel : travel);
+}
+
+static int16_t predict(const pong_state_t *state, const pong_vel_t *vel, bool left,
+                       uint16_t *ticks, pong_vel_t *vel_out)
+{
+    int32_t t;
+
+    if(left)
+    {
+        if(vel->b_dx >= 0) return -1;
+        t = ticks_to_cover(state->b_x - (state->l_x + PADDLE_W), -vel->b_dx);
+    }
+    else
+    {
+        if(vel->b_dx <= 0) return -1;
+        t = ticks_to_cover(state->r_x - BALL_SIZE - state->b_x, vel->b_dx);
+    }
+
+    if(ticks) *ticks = (uint16_t)t;
+    vel_out->b_dx = vel->b_dx;
+    return fold_y(state->b_y, vel->b_dy, t, &vel_out->b_dy);
+}
+
+int16_t ai_predict(const pong_state_t *state, const pong_vel_t *vel, bool left, uint16_t *ticks)
+{
+    pong_vel_t out;
+    return predict(state, vel, left, ticks, &out);
+}
+
+// Where the ball comes back to a paddle if the other paddle returns it
+static int16_t predict_return(const pong_state_t *state, const pong_vel_t *vel, bool left,
+                              uint16_t *ticks)
+{
+    pong_state_t hit = *state;
+    pong_vel_t back;
+    uint16_t t1, t2;
+
+    hit.b_y = predict(state, vel, !left, &t1, &back);
+    if(hit.b_y < 0) return -1;
+
+    // Same bounce as pong_step(): out of the paddle, reversed and faster
+    hit.b_x = (int16_t)(left ? state->r_x - BALL_SIZE : state->l_x + PADDLE_W);
+    back.b_dx = (int16_t)-back.b_dx;
+    if(back.b_dx > 0 && back.b_dx < MAX_BALL_SPEED) back.b_dx++;
+    if(back.b_dx < 0 && back.b_dx > -MAX_BALL_SPEED) back.b_dx--;
+
+    int16_t y = predict(&hit, &back, left, &t2, &back);
+    *ticks = (uint16_t)(t1 + t2);
+    return y;
+}
+
+static int16_t aim_error(void)
+{
+    if(g_config.error_px == 0) return 0;
+
+    // LCG keeps the AI deterministic for a given seed
+    g_rng = g_rng * 1664525UL + 1013904223UL;
+    return (int16_t)((int32_t)((g_rng >> 16) % (2U * g_config.error_px + 1U)) - g_config.error_px);
+}
+
+static void plan(ai_paddle_t *pad, const pong_state_t *state, const pong_vel_t *vel,
+                 bool left, bool new_shot)
+{
+    int16_t target;
+
+    // A wall bounce keeps the intercept; only a new shot (paddle bounce
+    // or serve) gets a fresh aim error and reaction delay
+    if(new_shot)
+    {
+        pad->error = aim_error();
+        pad->wait = g_config.reaction_ticks;
+    }
+
+    pad->intercept_y = ai_predict(state, vel, left, &pad->intercept_ticks);
+    if(pad->intercept_y < 0)
+    {
+        // Ball moving away: get ready for the return, assuming the other
+        // paddle makes it
+        pad->intercept_y = predict_return(state, vel, left, &pad->intercept_ticks);
+    }
+
+    if(pad->intercept_y < 0)
+    {
+        pad->intercept_ticks = 0;
+        target = (int16_t)(g_screen_h / 2 - PADDLE_H / 2);
+    }
+    else
+    {
+        // Line the paddle center up with the ball center, give or take
+        target = (int16_t)(pad->intercept_y + BALL_SIZE / 2 - PADDLE_H / 2 + pad->error);
+    }
+
+    if(target < 0) target = 0;
+    if(target > g_screen_h - PADDLE_H) target = (int16_t)(g_screen_h - PADDLE_H);
+
+    pad->target_y = target;
+    ++g_stats.predictions;
+}
+
+static int16_t move_toward(ai_paddle_t *pad, int16_t y)
+{
+    int16_t diff = (int16_t)(pad->target_y - y);
+
+    if(pad->wait)
+    {
+        --pad->wait;
+        return 0;
+    }
+
+    if(diff > PADDLE_SPEED) return PADDLE_SPEED;
+    if(diff < -PADDLE_SPEED) return -PADDLE_SPEED;
+    return diff;
+}
+
+void ai_init(const ai_config_t *config, int16_t screen_h)
+{
+    g_config = *config;
+    g_screen_h = screen_h;
+    g_rng = config->seed;
+    g_have_vel = false;
+    g_stats.ticks = 0;
+    g_stats.predictions = 0;
+}
+
+void ai_update(const pong_state_t *state, const pong_vel_t *vel, pong_input_t *input)
+{
+    ++g_stats.ticks;
+
+    // Re-plan only when the trajectory changed
+    if(!g_have_vel || vel->b_dx != g_last_vel.b_dx || vel->b_dy != g_last_vel.b_dy)
+    {
+        bool new_shot = !g_have_vel || vel->b_dx != g_last_vel.b_dx;
+
+        plan(&g_left, state, vel, true, new_shot);
+        plan(&g_right, state, vel, false, new_shot);
+        g_last_vel = *vel;
+        g_have_vel = true;
+    }
+
+    input->l_dy = move_toward(&g_left, state->l_y);
+    input->r_dy = move_toward(&g_right, state->r_y);
+}
+
+const ai_paddle_t *ai_get_paddle(bool left)
+{
+    return left ? &g_left : &g_right;
+}
+
+const ai_stats_t *ai_get_stats(void)
+{
+    return &g_stats;
+}
@@ -0,0 +1,98 @@
+#ifndef AI_H
+#define AI_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pong.h"
+
+// CPU paddle AI.
+//
+// Instead of chasing the ball every tick, each paddle works out where
+// the ball will cross its x-plane and moves there. The intercept is only
+// recomputed when the trajectory changes (the velocity differs from the
+// last tick: wall bounce, paddle bounce or serve), so a normal tick is a
+// velocity compare and one clamped move per paddle.
+//
+// The prediction unfolds wall reflections in closed form using the same
+// bounce rule as pong_step(): the ball is clamped onto the wall on the
+// tick it reaches it, then needs ceil(range / |dy|) ticks to cross to the
+// other wall. This makes the predicted y exact, not approximate.
+//
+// The paddle the ball moves away from plans for the return: the same
+// prediction is chained through the bounce on the other paddle, as if
+// that paddle makes it. A new shot (paddle bounce or serve) draws a
+// fresh aim error and restarts the reaction delay.
+
+#ifndef AI_REACTION_TICKS
+#define AI_REACTION_TICKS 4     // ticks before reacting to a new trajectory
+#endif
+
+#ifndef AI_ERROR_PX
+#define AI_ERROR_PX       12    // max aim error, +/- pixels from paddle center
+#endif
+
+typedef struct
+{
+    uint8_t reaction_ticks;     // delay before a paddle moves after a change
+    uint8_t error_px;           // aim error is drawn from [-error_px, error_px]
+    uint32_t seed;              // seed for the aim error
+} ai_config_t;
+
+typedef struct
+{
+    int16_t target_y;           // paddle y being moved to
+    int16_t intercept_y;        // predicted ball y at the plane, -1 if unknown
+    uint16_t intercept_ticks;   // ticks from the prediction to the crossing
+    int16_t error;              // aim error of the current shot
+    uint8_t wait;               // reaction ticks left
+} ai_paddle_t;
+
+typedef struct
+{
+    uint32_t ticks;             // ai_update() calls
+    uint32_t predictions;       // intercepts computed
+} ai_stats_t;
+
+/**
+ * @brief Sets the skill and clears the cached targets.
+ *
+ * @param config   Skill settings.
+ * @param screen_h Field height in pixels.
+ */
+void ai_init(const ai_config_t *config, int16_t screen_h);
+
+/**
+ * @brief Computes the paddle moves for the next tick.
+ *
+ * @param state Current state.
+ * @param vel   Current ball velocity.
+ * @param input Receives the paddle moves.
+ */
+void ai_update(const pong_state_t *state, const pong_vel_t *vel, pong_input_t *input);
+
+/**
+ * @brief Predicts where the ball crosses a paddle's x-plane.
+ *
+ * Uses the contact rule of pong_step(): the tick on which the ball
+ * first overlaps the paddle column.
+ *
+ * @param state Current state.
+ * @param vel   Current ball velocity.
+ * @param left  true for the left paddle, false for the right one.
+ * @param ticks Receives the number of ticks until the crossing (may be NULL).
+ * @return Ball y on that tick, or -1 if the ball moves away from the paddle.
+ */
+int16_t ai_predict(const pong_state_t *state, const pong_vel_t *vel, bool left, uint16_t *ticks);
+
+/**
+ * @brief Returns the cached plan of one paddle.
+ */
+const ai_paddle_t *ai_get_paddle(bool left);
+
+/**
+ * @brief Returns the work counters.
+ */
+const ai_stats_t *ai_get_stats(void);
+
+#endif
@@ -0,0 +1,629 @@
+#include "balls.h"
+
+#include <string.h>
+
+#include "arena.h"
+#include "ili9341.h"
+#include "perf.h"
+#include "power.h"
+#include "sprites.h"
+
+// Piece of a dirty rectangle inside one strip
+typedef struct
+{
+    int16_t x0, x1;     // [x0, x1)
+    int16_t y0, y1;     // [y0, y1)
+} piece_t;
+
+_Static_assert(sizeof(piece_t) == BALLS_PIECE_BYTES, "BALLS_ARENA_BYTES() assumes 8-byte pieces");
+#ifdef HOST_BUILD
+_Static_assert(ARENA_SIZE >= BALLS_ARENA_BYTES(BALLS_MAX), "host arena too small for ballbench");
+#endif
+
+static ball_pool_t g_pool;
+static pong_state_t g_paddles;
+static pong_state_t g_paddles_shown;
+static balls_stats_t g_stats;
+static int16_t g_screen_w;
+static int16_t g_screen_h;
+static uint32_t g_rand;
+
+// Uniform grid: balls of cell c are g_cell_items[g_cell_start[c] .. g_cell_start[c + 1])
+static uint16_t g_cell_start[BALLS_GRID_COLS * BALLS_GRID_ROWS + 1];
+static uint16_t g_cell_items[BALLS_MAX];
+static uint16_t g_ball_cell[BALLS_MAX];
+
+// From the arena while drawing: BALLS_SPAN_PIXELS of span pixels and two
+// piece lists, BALLS_PIECES_PER_BALL per ball each
+static uint8_t *g_span_buf;
+static piece_t *g_pieces;
+static piece_t *g_sorted;
+static uint16_t g_strip_start[BALLS_GRID_ROWS + 1];
+
+
+static uint32_t next_rand(void)
+{
+    g_rand = g_rand * 1664525UL + 1013904223UL;
+    return g_rand >> 16;
+}
+
+static inline uint16_t cell_of(int16_t x, int16_t y)
+{
+    int16_t cx = (int16_t)(x >> BALLS_CELL_SHIFT);
+    int16_t cy = (int16_t)(y >> BALLS_CELL_SHIFT);
+
+    if(cx < 0) cx = 0;
+    if(cy < 0) cy = 0;
+    if(cx >= BALLS_GRID_COLS) cx = BALLS_GRID_COLS - 1;
+    if(cy >= BALLS_GRID_ROWS) cy = BALLS_GRID_ROWS - 1;
+
+    return (uint16_t)(cy * BALLS_GRID_COLS + cx);
+}
+
+static void grid_build(void)
+{
+    const uint32_t cells = BALLS_GRID_COLS * BALLS_GRID_ROWS;
+
+    // Counting sort of the balls by the cell of their top-left corner
+    memset(g_cell_start, 0, sizeof(g_cell_start));
+    for(uint16_t i = 0; i < g_pool.count; ++i)
+    {
+        g_ball_cell[i] = cell_of(g_pool.x[i], g_pool.y[i]);
+        g_cell_start[g_ball_cell[i] + 1U]++;
+    }
+    for(uint32_t c = 0; c < cells; ++c)
+    {
+        g_cell_start[c + 1U] = (uint16_t)(g_cell_start[c + 1U] + g_cell_start[c]);
+    }
+    for(uint16_t i = 0; i < g_pool.count; ++i)
+    {
+        g_cell_items[g_cell_start[g_ball_cell[i]]++] = i;
+    }
+    // Placing the balls advanced each start to the next cell's start
+    for(uint32_t c = cells; c > 0; --c)
+    {
+        g_cell_start[c] = g_cell_start[c - 1U];
+    }
+    g_cell_start[0] = 0;
+}
+
+static void spawn(uint16_t i, int16_t dir)
+{
+    g_pool.x[i] = (int16_t)(g_screen_w / 2 - BALL_SIZE / 2);
+    g_pool.y[i] = (int16_t)(next_rand() % (uint32_t)(g_screen_h - BALL_SIZE));
+    g_pool.dx[i] = (int16_t)(dir * (int16_t)(2 + next_rand() % 2U));
+    g_pool.dy[i] = (int16_t)((int16_t)(next_rand() % 5U) - 2);
+    if(g_pool.dy[i] == 0) g_pool.dy[i] = 1;
+}
+
+static inline bool overlap(int16_t ax, int16_t ay, int16_t aw, int16_t ah,
+                           int16_t bx, int16_t by, int16_t bw, int16_t bh)
+{
+    return ax < bx + bw && bx < ax + aw && ay < by + bh && by < ay + ah;
+}
+
+static void collide_balls(void)
+{
+    for(uint16_t i = 0; i < g_pool.count; ++i)
+    {
+        int16_t cx = (int16_t)(g_pool.x[i] >> BALLS_CELL_SHIFT);
+        int16_t cy = (int16_t)(g_pool.y[i] >> BALLS_CELL_SHIFT);
+
+        // Balls are smaller than a cell, so any touching ball is anchored
+        // in the 3x3 block of cells around this one
+        for(int16_t gy = (int16_t)(cy - 1); gy <= cy + 1; ++gy)
+        {
+            if(gy < 0 || gy >= BALLS_GRID_ROWS) continue;
+
+            for(int16_t gx = (int16_t)(cx - 1); gx <= cx + 1; ++gx)
+            {
+                if(gx < 0 || gx >= BALLS_GRID_COLS) continue;
+
+                uint16_t c = (uint16_t)(gy * BALLS_GRID_COLS + gx);
+                for(uint16_t k = g_cell_start[c]; k < g_cell_start[c + 1U]; ++k)
+                {
+                    uint16_t j = g_cell_items[k];
+                    if(j <= i) continue; // each pair once
+
+                    g_stats.pair_tests++;
+
+                    int16_t rx = (int16_t)(g_pool.x[j] - g_pool.x[i]);
+                    int16_t ry = (int16_t)(g_pool.y[j] - g_pool.y[i]);
+                    if(rx <= -BALL_SIZE || rx >= BALL_SIZE || ry <= -BALL_SIZE || ry >= BALL_SIZE) continue;
+
+                    // Only bounce balls that are closing in, so touching
+                    // balls don't swap back and forth every tick
+                    int32_t rvx = g_pool.dx[j] - g_pool.dx[i];
+                    int32_t rvy = g_pool.dy[j] - g_pool.dy[i];
+                    if(rx * rvx + ry * rvy >= 0) continue;
+
+                    // Equal masses: swap velocities
+                    int16_t t;
+                    t = g_pool.dx[i]; g_pool.dx[i] = g_pool.dx[j]; g_pool.dx[j] = t;
+                    t = g_pool.dy[i]; g_pool.dy[i] = g_pool.dy[j]; g_pool.dy[j] = t;
+                    g_stats.collisions++;
+                }
+            }
+        }
+    }
+}
+
+static void collide_paddle(int16_t px, int16_t py, int16_t dir)
+{
+    // Cells a ball touching the paddle can be anchored in
+    int16_t gx0 = (int16_t)((px - BALL_SIZE) >> BALLS_CELL_SHIFT);
+    int16_t gx1 = (int16_t)((px + PADDLE_W) >> BALLS_CELL_SHIFT);
+    int16_t gy0 = (int16_t)((py - BALL_SIZE) >> BALLS_CELL_SHIFT);
+    int16_t gy1 = (int16_t)((py + PADDLE_H) >> BALLS_CELL_SHIFT);
+
+    for(int16_t gy = gy0; gy <= gy1; ++gy)
+    {
+        if(gy < 0 || gy >= BALLS_GRID_ROWS) continue;
+
+        for(int16_t gx = gx0; gx <= gx1; ++gx)
+        {
+            if(gx < 0 || gx >= BALLS_GRID_COLS) continue;
+
+            uint16_t c = (uint16_t)(gy * BALLS_GRID_COLS + gx);
+            for(uint16_t k = g_cell_start[c]; k < g_cell_start[c + 1U]; ++k)
+            {
+                uint16_t i = g_cell_items[k];
+                g_stats.paddle_tests++;
+
+                // Same contact rule as pong_step(), moving away only
+                if(g_pool.dx[i] * dir > 0) continue;
+                if(!overlap(g_pool.x[i], g_pool.y[i], BALL_SIZE, BALL_SIZE,
+                            (int16_t)(px - 1), py, PADDLE_W + 2, PADDLE_H + 1)) continue;
+
+                g_pool.x[i] = (dir > 0) ? (int16_t)(px + PADDLE_W) : (int16_t)(px - BALL_SIZE);
+                g_pool.dx[i] = (int16_t)-g_pool.dx[i];
+                if(g_pool.dx[i] > 0 && g_pool.dx[i] < MAX_BALL_SPEED) g_pool.dx[i]++;
+                if(g_pool.dx[i] < 0 && g_pool.dx[i] > -MAX_BALL_SPEED) g_pool.dx[i]--;
+            }
+        }
+    }
+}
+
+static int16_t paddle_target(int16_t px, int16_t dir)
+{
+    // Follow the nearest ball heading for this paddle
+    int16_t best_y = (int16_t)(g_screen_h / 2);
+    int16_t best_d = INT16_MAX;
+
+    for(uint16_t i = 0; i < g_pool.count; ++i)
+    {
+        if(g_pool.dx[i] * dir >= 0) continue;
+
+        int16_t d = (int16_t)(dir > 0 ? g_pool.x[i] - px : px - g_pool.x[i]);
+        if(d >= 0 && d < best_d)
+        {
+            best_d = d;
+            best_y = g_pool.y[i];
+        }
+    }
+
+    return best_y;
+}
+
+static void move_paddle(int16_t *py, int16_t target)
+{
+    if(*py + PADDLE_H / 2 < target) *py += PADDLE_SPEED;
+    else if(*py + PADDLE_H / 2 > target) *py -= PADDLE_SPEED;
+
+    if(*py < 0) *py = 0;
+    if(*py + PADDLE_H > g_screen_h) *py = (int16_t)(g_screen_h - PADDLE_H);
+}
+
+void balls_init(uint16_t count, uint32_t seed)
+{
+    uint16_t w, h;
+    ili9341_get_screen_size(&w, &h);
+    g_screen_w = (int16_t)w;
+    g_screen_h = (int16_t)h;
+    sprites_init();
+
+    if(count > BALLS_MAX) count = BALLS_MAX;
+    memset(&g_pool, 0, sizeof(g_pool));
+    memset(&g_stats, 0, sizeof(g_stats));
+    g_rand = seed;
+
+    g_pool.count = count;
+    for(uint16_t i = 0; i < count; ++i)
+    {
+        spawn(i, (i & 1U) ? -1 : 1);
+        // Spread them out instead of starting on the center line
+        g_pool.x[i] = (int16_t)(PADDLE_W + 8 + next_rand() % (uint32_t)(g_screen_w - 2 * (PADDLE_W + 8) - BALL_SIZE));
+        g_pool.shown_x[i] = g_pool.x[i];
+        g_pool.shown_y[i] = g_pool.y[i];
+    }
+
+    g_paddles.l_x = 3;
+    g_paddles.l_y = (int16_t)(g_screen_h / 2 - PADDLE_H / 2);
+    g_paddles.r_x = (int16_t)(g_screen_w - PADDLE_W - 3);
+    g_paddles.r_y = g_paddles.l_y;
+    g_paddles_shown = g_paddles;
+
+    // Full redraw: background and center line, then everything on top
+    ili9341_fill_screen(COLOR_BLACK);
+    for(uint16_t y = 0; y < g_screen_h; y += (CENTER_DASH_H + CENTER_GAP_H))
+    {
+        ili9341_fill_rect((uint16_t)(g_screen_w / 2 - 1),
+                          y,
+                          CENTER_LINE_W,
+                          (y + CENTER_DASH_H <= g_screen_h) ? CENTER_DASH_H : (uint16_t)(g_screen_h - y),
+                          COLOR_WHITE);
+    }
+    ili9341_fill_rect((uint16_t)g_paddles.l_x, (uint16_t)g_paddles.l_y, PADDLE_W, PADDLE_H, COLOR_WHITE);
+    ili9341_fill_rect((uint16_t)g_paddles.r_x, (uint16_t)g_paddles.r_y, PADDLE_W, PADDLE_H, COLOR_WHITE);
+    for(uint16_t i = 0; i < count; ++i)
+    {
+        ili9341_fill_rect((uint16_t)g_pool.x[i], (uint16_t)g_pool.y[i], BALL_SIZE, BALL_SIZE, COLOR_WHITE);
+    }
+}
+
+void balls_step(void)
+{
+    g_stats.pair_tests = 0;
+    g_stats.collisions = 0;
+    g_stats.paddle_tests = 0;
+
+    // Integrate and bounce off the top and bottom walls
+    for(uint16_t i = 0; i < g_pool.count; ++i)
+    {
+        g_pool.x[i] = (int16_t)(g_pool.x[i] + g_pool.dx[i]);
+        g_pool.y[i] = (int16_t)(g_pool.y[i] + g_pool.dy[i]);
+
+        if(g_pool.y[i] <= 0)
+        {
+            g_pool.y[i] = 0;
+            g_pool.dy[i] = (int16_t)-g_pool.dy[i];
+        }
+        if(g_pool.y[i] + BALL_SIZE >= g_screen_h)
+        {
+            g_pool.y[i] = (int16_t)(g_screen_h - BALL_SIZE);
+            g_pool.dy[i] = (int16_t)-g_pool.dy[i];
+        }
+    }
+
+    grid_build();
+    collide_balls();
+    collide_paddle(g_paddles.l_x, g_paddles.l_y, 1);
+    collide_paddle(g_paddles.r_x, g_paddles.r_y, -1);
+
+    // Respawn balls that got past a paddle
+    for(uint16_t i = 0; i < g_pool.count; ++i)
+    {
+        if(g_pool.x[i] < 0 || g_pool.x[i] + BALL_SIZE > g_screen_w)
+        {
+            spawn(i, (g_pool.dx[i] > 0) ? -1 : 1);
+        }
+    }
+
+    move_paddle(&g_paddles.l_y, paddle_target(g_paddles.l_x, 1));
+    move_paddle(&g_paddles.r_y, paddle_target(g_paddles.r_x, -1));
+}
+
+static void compose_rect(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+                         int16_t rx, int16_t ry, int16_t rw, int16_t rh)
+{
+    const uint16_t stride = (uint16_t)(x1 - x0);
+
+    int16_t ax = rx > x0 ? rx : x0;
+    int16_t ay = ry > y0 ? ry : y0;
+    int16_t bx = rx + rw < x1 ? (int16_t)(rx + rw) : x1;
+    int16_t by = ry + rh < y1 ? (int16_t)(ry + rh) : y1;
+
+#ifdef HOST_BUILD
+    sim_advance(SIM_CYCLES_PER_COMPOSE_RECT);
+    if(ax < bx && ay < by)
+    {
+        sim_advance((uint64_t)(by - ay) * (SIM_CYCLES_PER_COMPOSE_ROW + (uint64_t)(bx - ax) * SIM_CYCLES_PER_COMPOSE_PIXEL));
+    }
+#endif
+
+    for(int16_t y = ay; y < by; ++y)
+    {
+        uint8_t *row = &g_span_buf[((uint32_t)(y - y0) * stride + (uint32_t)(ax - x0)) * 2U];
+        for(int16_t x = ax; x < bx; ++x)
+        {
+            *row++ = (uint8_t)(COLOR_WHITE >> 8);
+            *row++ = (uint8_t)COLOR_WHITE;
+        }
+    }
+}
+
+static void compose_span(int16_t x0, int16_t y0, int16_t x1, int16_t y1)
+{
+    const int16_t line_x = (int16_t)(g_screen_w / 2 - 1);
+    const uint32_t pixels = (uint32_t)(x1 - x0) * (uint32_t)(y1 - y0);
+    const uint32_t start = perf_cycles();
+
+    memset(g_span_buf, 0, pixels * 2U); // COLOR_BLACK
+#ifdef HOST_BUILD
+    sim_advance((uint64_t)pixels * SIM_CYCLES_PER_CLEAR_PIXEL);
+#endif
+
+    // Center line dashes, one rectangle each
+    if(x0 < line_x + CENTER_LINE_W && line_x < x1)
+    {
+        const int16_t pitch = CENTER_DASH_H + CENTER_GAP_H;
+        for(int16_t dash = (int16_t)(y0 - y0 % pitch); dash < y1; dash = (int16_t)(dash + pitch))
+        {
+            compose_rect(x0, y0, x1, y1, line_x, dash, CENTER_LINE_W, CENTER_DASH_H);
+        }
+    }
+
+    compose_rect(x0, y0, x1, y1, g_paddles.l_x, g_paddles.l_y, PADDLE_W, PADDLE_H);
+    compose_rect(x0, y0, x1, y1, g_paddles.r_x, g_paddles.r_y, PADDLE_W, PADDLE_H);
+
+    // Balls anchored in the cells this span can see
+    int16_t gx0 = (int16_t)((x0 - BALL_SIZE) >> BALLS_CELL_SHIFT);
+    int16_t gx1 = (int16_t)((x1 - 1) >> BALLS_CELL_SHIFT);
+    int16_t gy0 = (int16_t)((y0 - BALL_SIZE) >> BALLS_CELL_SHIFT);
+    int16_t gy1 = (int16_t)((y1 - 1) >> BALLS_CELL_SHIFT);
+
+    for(int16_t gy = gy0; gy <= gy1; ++gy)
+    {
+        if(gy < 0 || gy >= BALLS_GRID_ROWS) continue;
+
+        for(int16_t gx = gx0; gx <= gx1; ++gx)
+        {
+            if(gx < 0 || gx >= BALLS_GRID_COLS) continue;
+
+            uint16_t c = (uint16_t)(gy * BALLS_GRID_COLS + gx);
+            for(uint16_t k = g_cell_start[c]; k < g_cell_start[c + 1U]; ++k)
+            {
+                uint16_t i = g_cell_items[k];
+                compose_rect(x0, y0, x1, y1, g_pool.x[i], g_pool.y[i], BALL_SIZE, BALL_SIZE);
+            }
+        }
+    }
+
+    g_stats.compose_cycles += perf_cycles() - start;
+
+    ili9341_draw_buffer((uint16_t)x0, (uint16_t)y0, (uint16_t)(x1 - x0), (uint16_t)(y1 - y0), g_span_buf);
+
+    g_stats.windows++;
+    g_stats.pixels += pixels;
+}
+
+static uint32_t add_pieces(uint32_t n, int16_t x, int16_t y)
+{
+    int16_t y1 = (int16_t)(y + BALL_SIZE);
+
+    // Cut at strip boundaries so every piece belongs to one strip
+    while(y < y1)
+    {
+        int16_t strip_end = (int16_t)(((y >> BALLS_CELL_SHIFT) + 1) << BALLS_CELL_SHIFT);
+        int16_t end = strip_end < y1 ? strip_end : y1;
+
+        g_pieces[n].x0 = x;
+        g_pieces[n].x1 = (int16_t)(x + BALL_SIZE);
+        g_pieces[n].y0 = y;
+        g_pieces[n].y1 = end;
+        ++n;
+        y = end;
+    }
+
+    return n;
+}
+
+static void draw_batched(void)
+{
+    uint32_t n = 0;
+
+    for(uint16_t i = 0; i < g_pool.count; ++i)
+    {
+        if(g_pool.x[i] == g_pool.shown_x[i] && g_pool.y[i] == g_pool.shown_y[i]) continue;
+
+        n = add_pieces(n, g_pool.shown_x[i], g_pool.shown_y[i]);
+        n = add_pieces(n, g_pool.x[i], g_pool.y[i]);
+    }
+
+    // Bucket the pieces by strip
+    memset(g_strip_start, 0, sizeof(g_strip_start));
+    for(uint32_t p = 0; p < n; ++p)
+    {
+        g_strip_start[(g_pieces[p].y0 >> BALLS_CELL_SHIFT) + 1]++;
+    }
+    for(uint32_t s = 0; s < BALLS_GRID_ROWS; ++s)
+    {
+        g_strip_start[s + 1U] = (uint16_t)(g_strip_start[s + 1U] + g_strip_start[s]);
+    }
+    for(uint32_t p = 0; p < n; ++p)
+    {
+        uint32_t s = (uint32_t)(g_pieces[p].y0 >> BALLS_CELL_SHIFT);
+        g_sorted[g_strip_start[s]++] = g_pieces[p];
+    }
+    // Placing the pieces advanced each start to the next strip's start
+    for(uint32_t s = BALLS_GRID_ROWS; s > 0; --s)
+    {
+        g_strip_start[s] = g_strip_start[s - 1U];
+    }
+    g_strip_start[0] = 0;
+
+    for(uint32_t s = 0; s < BALLS_GRID_ROWS; ++s)
+    {
+        piece_t *strip = &g_sorted[g_strip_start[s]];
+        uint32_t count = (uint32_t)(g_strip_start[s + 1U] - g_strip_start[s]);
+        if(count == 0) continue;
+
+        // Insertion sort by x; strips hold a handful of pieces
+        for(uint32_t a = 1; a < count; ++a)
+        {
+            piece_t t = strip[a];
+            uint32_t b = a;
+            while(b > 0 && strip[b - 1U].x0 > t.x0)
+            {
+                strip[b] = strip[b - 1U];
+                --b;
+            }
+            strip[b] = t;
+        }
+
+        // Merge neighbours into spans while the black pixels a merge adds
+        // cost less than opening another window
+        piece_t span = strip[0];
+        uint32_t useful = (uint32_t)(span.x1 - span.x0) * (uint32_t)(span.y1 - span.y0);
+        for(uint32_t a = 1; a <= count; ++a)
+        {
+            if(a < count)
+            {
+                const piece_t *p = &strip[a];
+                int16_t x1 = p->x1 > span.x1 ? p->x1 : span.x1;
+                int16_t y0 = p->y0 < span.y0 ? p->y0 : span.y0;
+                int16_t y1 = p->y1 > span.y1 ? p->y1 : span.y1;
+                uint32_t area = (uint32_t)(x1 - span.x0) * (uint32_t)(y1 - y0);
+                uint32_t piece = (uint32_t)(p->x1 - p->x0) * (uint32_t)(p->y1 - p->y0);
+
+                if(area <= BALLS_SPAN_PIXELS && area <= useful + piece + BALLS_MERGE_WASTE)
+                {
+                    span.x1 = x1;
+                    span.y0 = y0;
+                    span.y1 = y1;
+                    useful += piece;
+                    continue;
+                }
+            }
+
+            // Clip to the screen; pieces of balls leaving the field can stick out
+            if(span.x0 < 0) span.x0 = 0;
+            if(span.x1 > g_screen_w) span.x1 = g_screen_w;
+            if(span.y1 > g_screen_h) span.y1 = g_screen_h;
+            if(span.x0 < span.x1 && span.y0 < span.y1)
+            {
+                compose_span(span.x0, span.y0, span.x1, span.y1);
+            }
+
+            if(a < count)
+            {
+                span = strip[a];
+                useful = (uint32_t)(span.x1 - span.x0) * (uint32_t)(span.y1 - span.y0);
+            }
+        }
+    }
+}
+
+// Redraws the center line dashes under an erased ball
+static void repair_center_line(int16_t x, int16_t y)
+{
+    const int16_t line_x = (int16_t)(g_screen_w / 2 - 1);
+    const int16_t pitch = CENTER_DASH_H + CENTER_GAP_H;
+
+    if(x >= line_x + CENTER_LINE_W || line_x >= x + BALL_SIZE) return;
+
+    for(int16_t dash = (int16_t)(y - y % pitch); dash < y + BALL_SIZE; dash = (int16_t)(dash + pitch))
+    {
+        int16_t y0 = (dash > y) ? dash : y;
+        int16_t y1 = (int16_t)(dash + CENTER_DASH_H);
+        if(y1 > y + BALL_SIZE) y1 = (int16_t)(y + BALL_SIZE);
+        if(y1 > g_screen_h) y1 = g_screen_h;
+        if(y0 >= y1) continue;
+
+        ili9341_fill_rect((uint16_t)line_x, (uint16_t)y0, CENTER_LINE_W, (uint16_t)(y1 - y0), COLOR_WHITE);
+        g_stats.windows++;
+        g_stats.pixels += (uint32_t)CENTER_LINE_W * (uint32_t)(y1 - y0);
+    }
+}
+
+static void draw_per_ball(void)
+{
+    // Erase everything first so a ball's erase can't cut into another ball
+    for(uint16_t i = 0; i < g_pool.count; ++i)
+    {
+        if(g_pool.x[i] == g_pool.shown_x[i] && g_pool.y[i] == g_pool.shown_y[i]) continue;
+
+        sprites_draw(SPRITE_BALL, g_pool.shown_x[i], g_pool.shown_y[i], false);
+        g_stats.windows++;
+        g_stats.pixels += BALL_SIZE * BALL_SIZE;
+
+        repair_center_line(g_pool.shown_x[i], g_pool.shown_y[i]);
+    }
+    for(uint16_t i = 0; i < g_pool.count; ++i)
+    {
+        sprites_draw(SPRITE_BALL, g_pool.x[i], g_pool.y[i], true);
+        g_stats.windows++;
+        g_stats.pixels += BALL_SIZE * BALL_SIZE;
+    }
+}
+
+static void draw_paddle(int16_t x, int16_t shown_y, int16_t y)
+{
+    if(shown_y == y) return;
+
+    sprites_draw(SPRITE_PADDLE, x, shown_y, false);
+    sprites_draw(SPRITE_PADDLE, x, y, true);
+    g_stats.windows += 2;
+    g_stats.pixels += 2 * PADDLE_W * PADDLE_H;
+}
+
+void balls_draw(bool batched)
+{
+    g_stats.windows = 0;
+    g_stats.pixels = 0;
+    g_stats.compose_cycles = 0;
+
+    // Paddles first: the ball spans compose paddles in, so they can't cut them
+    draw_paddle(g_paddles.l_x, g_paddles_shown.l_y, g_paddles.l_y);
+    draw_paddle(g_paddles.r_x, g_paddles_shown.r_y, g_paddles.r_y);
+    g_paddles_shown = g_paddles;
+
+    const arena_mark_t mark = arena_mark();
+    if(batched)
+    {
+        const uint32_t pieces = (uint32_t)g_pool.count * BALLS_PIECES_PER_BALL * sizeof(piece_t);
+        g_span_buf = arena_alloc(BALLS_SPAN_PIXELS * 2U);
+        g_pieces = arena_alloc(pieces);
+        g_sorted = arena_alloc(pieces);
+    }
+
+    if(g_span_buf && g_pieces && g_sorted)
+    {
+        grid_build();
+        draw_batched();
+    }
+    else
+    {
+        draw_per_ball();
+    }
+
+    g_span_buf = NULL;
+    g_pieces = g_sorted = NULL;
+    arena_release(mark);
+
+    memcpy(g_pool.shown_x, g_pool.x, sizeof(g_pool.x));
+    memcpy(g_pool.shown_y, g_pool.y, sizeof(g_pool.y));
+}
+
+const ball_pool_t *balls_get_pool(void)
+{
+    return &g_pool;
+}
+
+const pong_state_t *balls_get_paddles(void)
+{
+    return &g_paddles;
+}
+
+const balls_stats_t *balls_get_stats(void)
+{
+    return &g_stats;
+}
+
+void balls_play(uint16_t count)
+{
+    balls_init(count, perf_cycles());
+
+    uint32_t deadline = power_now();
+    while(1)
+    {
+        deadline += PERF_MS_TO_CYCLES(FRAME_MS);
+        arena_frame_reset();
+
+        balls_step();
+        balls_draw(g_pool.count >= BALLS_BATCH_MIN);
+
+        power_frame_idle(deadline);
+        if(power_get_stats()->overrun_cycles) deadline = power_now();
+    }
+}
@@ -0,0 +1,120 @@
+#ifndef BALLS_H
+#define BALLS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pong.h"
+
+// Multi-ball stress mode.
+//
+// Balls live in a fixed-capacity structure-of-arrays pool. Every tick a
+// uniform grid over the field is rebuilt with a counting sort, and both
+// ball-ball and ball-paddle tests only look at balls in nearby cells.
+//
+// Drawing can be batched: the old and new rectangles of every ball are
+// cut into horizontal strips, neighbouring pieces in a strip are merged
+// into spans, and each span is composed (background, center line,
+// paddles, balls) into a buffer and sent as one window. Pieces only merge
+// when the extra background is cheaper than opening another window
+// (BALLS_MERGE_WASTE, measured with host/ballbench).
+//
+// Spans save bus time, but composing them costs CPU time that drawing
+// ball by ball does not. host/ballbench counts both, the compose part
+// from a per-pixel model, and finds ball by ball cheaper at every count
+// up to BALLS_MAX, so the demo only batches from BALLS_BATCH_MIN balls.
+// balls_get_stats() has the compose cycles from the DWT counter on the
+// board, to check the model and set the threshold from.
+
+#define BALLS_MAX          256
+#define BALLS_CELL_SHIFT   4                        // 16x16 pixel cells
+#define BALLS_CELL_SIZE    (1 << BALLS_CELL_SHIFT)
+#define BALLS_GRID_COLS    ((320 + BALLS_CELL_SIZE - 1) / BALLS_CELL_SIZE)
+#define BALLS_GRID_ROWS    ((320 + BALLS_CELL_SIZE - 1) / BALLS_CELL_SIZE)
+#define BALLS_SPAN_PIXELS  1024                     // compose buffer size
+#define BALLS_MERGE_WASTE  12                       // pixels a window setup is worth
+#define BALLS_PIECES_PER_BALL 4                     // old + new rect, each over <= 2 strips
+#define BALLS_PIECE_BYTES  8
+
+// Arena bytes balls_draw(true) takes for count balls
+#define BALLS_ARENA_BYTES(count) \
+    (BALLS_SPAN_PIXELS * 2U + 2U * BALLS_PIECES_PER_BALL * BALLS_PIECE_BYTES * (uint32_t)(count))
+
+#ifndef BALLS_BATCH_MIN
+#define BALLS_BATCH_MIN    (BALLS_MAX + 1)          // fewest balls worth batching
+#endif
+
+typedef struct
+{
+    int16_t x[BALLS_MAX];
+    int16_t y[BALLS_MAX];
+    int16_t dx[BALLS_MAX];
+    int16_t dy[BALLS_MAX];
+    int16_t shown_x[BALLS_MAX];     // position currently on screen
+    int16_t shown_y[BALLS_MAX];
+    uint16_t count;
+} ball_pool_t;
+
+typedef struct
+{
+    // Last tick
+    uint32_t pair_tests;        // ball-ball candidates from the grid
+    uint32_t collisions;        // ball-ball bounces
+    uint32_t paddle_tests;      // ball-paddle candidates from the grid
+
+    // Last frame
+    uint32_t windows;           // display windows opened
+    uint32_t pixels;            // pixels sent
+    uint32_t compose_cycles;    // CPU cycles building span pixels in RAM
+                                // (DWT on the board, modelled on the host)
+} balls_stats_t;
+
+/**
+ * @brief Spawns balls, resets the paddles and draws the field.
+ *
+ * The display must already be initialized.
+ *
+ * @param count Number of balls, clamped to BALLS_MAX.
+ * @param seed  Seed for the spawn positions and velocities.
+ */
+void balls_init(uint16_t count, uint32_t seed);
+
+/**
+ * @brief Advances every ball and both paddles by one tick.
+ */
+void balls_step(void);
+
+/**
+ * @brief Draws everything that moved since the last draw.
+ *
+ * @param batched true to compose merged spans, false to erase and draw
+ *                every ball with its own windows, putting back the
+ *                center line under the erased ones.
+ *                Batching needs BALLS_ARENA_BYTES(count) of arena.h
+ *                scratch and falls back to per-ball drawing without it.
+ */
+void balls_draw(bool batched);
+
+/**
+ * @brief Returns the ball pool.
+ */
+const ball_pool_t *balls_get_pool(void);
+
+/**
+ * @brief Returns the paddle positions (ball fields unused).
+ */
+const pong_state_t *balls_get_paddles(void);
+
+/**
+ * @brief Returns the work counters of the last tick and frame.
+ */
+const balls_stats_t *balls_get_stats(void);
+
+/**
+ * @brief Runs the stress demo forever.
+ *
+ * @param count Number of balls.
+ */
+void balls_play(uint16_t count);
+
+#endif
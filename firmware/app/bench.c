@@ -0,0 +1,379 @@
+#include "bench.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "arena.h"
+#include "ili9341.h"
+#include "perf.h"
+#include "pong.h"
+#include "surface.h"
+
+// Both own USART2: the report lines would land in the middle of the mirror
+// stream, and bench_play() resetting CR3 stops the mirror's DMA
+#if defined(DISPLAY_BENCH) && defined(ILI9341_MIRROR)
+#error "DISPLAY_BENCH and ILI9341_MIRROR both use USART2; build one or the other"
+#endif
+
+#ifndef HOST_BUILD
+#define BENCH_RCC_AHB1ENR   (*(volatile uint32_t *)0x40023830UL)
+#define BENCH_RCC_APB1ENR   (*(volatile uint32_t *)0x40023840UL)
+#define BENCH_GPIOA_MODER   (*(volatile uint32_t *)0x40020000UL)
+#define BENCH_GPIOA_AFRL    (*(volatile uint32_t *)0x40020020UL)
+#define BENCH_USART2_BASE   0x40004400UL
+#define BENCH_USART2_SR     (*(volatile uint32_t *)(BENCH_USART2_BASE + 0x00UL))
+#define BENCH_USART2_DR     (*(volatile uint32_t *)(BENCH_USART2_BASE + 0x04UL))
+#define BENCH_USART2_BRR    (*(volatile uint32_t *)(BENCH_USART2_BASE + 0x08UL))
+#define BENCH_USART2_CR1    (*(volatile uint32_t *)(BENCH_USART2_BASE + 0x0CUL))
+#define BENCH_USART2_CR3    (*(volatile uint32_t *)(BENCH_USART2_BASE + 0x14UL))
+
+#define BENCH_AHB1ENR_GPIOA (1U << 0)
+#define BENCH_APB1ENR_USART2 (1U << 17)
+#define BENCH_SR_TXE        (1U << 7)
+#define BENCH_CR1_TE        (1U << 3)
+#define BENCH_CR1_UE        (1U << 13)
+#define BENCH_PCLK1_HZ      PERF_CPU_HZ // APB1 x1 out of reset
+#endif
+
+typedef enum
+{
+    FN_PIXEL = 0,
+    FN_HLINE,
+    FN_VLINE,
+    FN_FILL_RECT,
+    FN_SPRITE,
+    FN_BUFFER,
+    FN_STREAM,
+    FN_SCREEN,
+    FN_COUNT
+} bench_fn_t;
+
+typedef enum
+{
+    SHAPE_PIXEL = 0,
+    SHAPE_BALL,
+    SHAPE_PADDLE,
+    SHAPE_LINE,     // full width; full height for vertical lines
+    SHAPE_SCREEN,
+    SHAPE_COUNT
+} bench_shape_t;
+
+#define SHAPE_BIT(s) (1U << (s))
+
+typedef struct
+{
+    const char *name;
+    uint8_t shapes;     // SHAPE_BIT(bench_shape_t) mask
+} bench_case_t;
+
+typedef struct
+{
+    char text[BENCH_LINE_CHARS];
+    uint32_t len;
+} line_t;
+
+static const bench_case_t g_cases[FN_COUNT] = {
+    [FN_PIXEL]     = { "draw_pixel",  SHAPE_BIT(SHAPE_PIXEL) },
+    [FN_HLINE]     = { "draw_hline",  SHAPE_BIT(SHAPE_PIXEL) | SHAPE_BIT(SHAPE_LINE) },
+    [FN_VLINE]     = { "draw_vline",  SHAPE_BIT(SHAPE_PIXEL) | SHAPE_BIT(SHAPE_LINE) },
+    [FN_FILL_RECT] = { "fill_rect",   SHAPE_BIT(SHAPE_PIXEL) | SHAPE_BIT(SHAPE_BALL) | SHAPE_BIT(SHAPE_PADDLE) |
+                                      SHAPE_BIT(SHAPE_LINE) | SHAPE_BIT(SHAPE_SCREEN) },
+    [FN_SPRITE]    = { "draw_sprite", SHAPE_BIT(SHAPE_BALL) | SHAPE_BIT(SHAPE_PADDLE) },
+    [FN_BUFFER]    = { "draw_buffer", SHAPE_BIT(SHAPE_PIXEL) | SHAPE_BIT(SHAPE_BALL) | SHAPE_BIT(SHAPE_PADDLE) |
+                                      SHAPE_BIT(SHAPE_LINE) },
+    [FN_STREAM]    = { "write_data",  SHAPE_BIT(SHAPE_PIXEL) | SHAPE_BIT(SHAPE_BALL) | SHAPE_BIT(SHAPE_PADDLE) |
+                                      SHAPE_BIT(SHAPE_LINE) | SHAPE_BIT(SHAPE_SCREEN) },
+    [FN_SCREEN]    = { "fill_screen", SHAPE_BIT(SHAPE_SCREEN) },
+};
+
+// Pixel data for draw_buffer and write_data; a full-screen write sends
+// one row at a time
+static uint8_t g_data[BENCH_ROW_PIXELS * 2];
+
+// The game's two sprite shapes, drawing from the same data
+static ili9341_sprite_t g_ball_sprite = ILI9341_SPRITE(BALL_SIZE, BALL_SIZE, g_data);
+static ili9341_sprite_t g_paddle_sprite = ILI9341_SPRITE(PADDLE_W, PADDLE_H, g_data);
+
+static const uint16_t g_expand_colors[SURFACE_PALETTE_SIZE] = {
+    COLOR_BLACK, COLOR_WHITE, COLOR_RED, COLOR_BLUE,
+    COLOR_YELLOW, COLOR_CYAN, COLOR_MAGENTA, COLOR_GRAY,
+    COLOR_ORANGE, COLOR_PURPLE, 0x07E0, 0x0410,
+    0x8000, 0x0010, 0x4208, 0xC618
+};
+static surface_palette_t g_palette;
+static uint8_t g_row[SURFACE_BYTES(SURFACE_CHUNK_PIXELS, 1)];
+
+
+// Report lines, built without printf so the board needs no libc I/O
+
+static void put_text(line_t *line, const char *s, uint32_t width)
+{
+    uint32_t n = 0;
+
+    while(s[n] && line->len < BENCH_LINE_CHARS - 1U) line->text[line->len++] = s[n++];
+    while(n++ < width && line->len < BENCH_LINE_CHARS - 1U) line->text[line->len++] = ' ';
+    line->text[line->len] = '\0';
+}
+
+static void put_u32(line_t *line, uint32_t v, uint32_t width)
+{
+    char digits[11];
+    uint32_t n = 0;
+
+    do
+    {
+        digits[n++] = (char)('0' + v % 10U);
+        v /= 10U;
+    } while(v);
+
+    while(width-- > n) put_text(line, " ", 0);
+    while(n) line->text[line->len++] = digits[--n];
+    line->text[line->len] = '\0';
+}
+
+// Tenths as "12.3"
+static void put_tenths(line_t *line, uint32_t tenths, uint32_t width)
+{
+    put_u32(line, tenths / 10U, width > 2U ? width - 2U : 0U);
+    put_text(line, ".", 0);
+    put_u32(line, tenths % 10U, 1);
+}
+
+// "WxH", lined up on the x
+static void put_size(line_t *line, uint16_t w, uint16_t h)
+{
+    line_t height = { .len = 0 };
+
+    put_u32(line, w, 3);
+    put_text(line, "x", 0);
+    put_u32(&height, h, 0);
+    put_text(line, height.text, 5);
+}
+
+static void shape_size(bench_fn_t fn, bench_shape_t shape, uint16_t sw, uint16_t sh,
+                       uint16_t *w, uint16_t *h)
+{
+    switch(shape)
+    {
+        default:
+        case SHAPE_PIXEL:  *w = 1;          *h = 1;          break;
+        case SHAPE_BALL:   *w = BALL_SIZE;  *h = BALL_SIZE;  break;
+        case SHAPE_PADDLE: *w = PADDLE_W;   *h = PADDLE_H;   break;
+        case SHAPE_SCREEN: *w = sw;         *h = sh;         break;
+        case SHAPE_LINE:
+            if(fn == FN_VLINE) { *w = 1;  *h = sh; }
+            else               { *w = sw; *h = 1;  }
+            break;
+    }
+}
+
+static void draw(bench_fn_t fn, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color)
+{
+    switch(fn)
+    {
+        case FN_PIXEL:     ili9341_draw_pixel(x, y, color);         break;
+        case FN_HLINE:     ili9341_draw_hline(x, y, w, color);      break;
+        case FN_VLINE:     ili9341_draw_vline(x, y, h, color);      break;
+        case FN_FILL_RECT: ili9341_fill_rect(x, y, w, h, color);    break;
+        case FN_BUFFER:    ili9341_draw_buffer(x, y, w, h, g_data); break;
+
+        case FN_SPRITE:
+            ili9341_draw_sprite(h == PADDLE_H ? &g_paddle_sprite : &g_ball_sprite, x, y);
+            break;
+        case FN_SCREEN:    ili9341_fill_screen(color);              break;
+
+        case FN_STREAM:
+            ili9341_begin_write(x, y, w, h);
+            for(uint16_t row = 0; row < h; ++row) ili9341_write_data(g_data, (uint32_t)w * 2U);
+            ili9341_end_write();
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void run_case(bench_fn_t fn, bench_shape_t shape, uint32_t cycles_per_byte, bench_out_t out)
+{
+    uint16_t sw, sh, w, h;
+
+    ili9341_get_screen_size(&sw, &sh);
+    shape_size(fn, shape, sw, sh, &w, &h);
+
+    const uint32_t area = (uint32_t)w * h;
+    uint32_t calls = BENCH_PIXELS / area;
+    if(calls < 1U) calls = 1U;
+    if(calls > BENCH_MAX_CALLS) calls = BENCH_MAX_CALLS;
+
+    // Walk the shape around the screen so no two calls hit the same spot
+    uint32_t bytes = ili9341_get_tx_bytes();
+    uint32_t start = perf_cycles();
+    for(uint32_t i = 0; i < calls; ++i)
+    {
+        uint16_t x = (uint16_t)((i * 13U) % (sw - w + 1U));
+        uint16_t y = (uint16_t)((i * 7U) % (sh - h + 1U));
+        draw(fn, x, y, w, h, (i & 1U) ? COLOR_WHITE : COLOR_BLUE);
+    }
+    uint32_t cycles = perf_cycles() - start;
+    bytes = ili9341_get_tx_bytes() - bytes;
+
+    if(!cycles) cycles = 1;
+
+    uint64_t pixels = (uint64_t)area * calls;
+    uint64_t pixel_cycles = pixels * 2U * cycles_per_byte;
+    uint32_t kpx_s = (uint32_t)(pixels * (PERF_CPU_HZ / 1000UL) / cycles);
+    uint32_t ovh = pixel_cycles >= cycles ? 0U : (uint32_t)(1000U - pixel_cycles * 1000U / cycles);
+
+    line_t line = { .len = 0 };
+    put_u32(&line, (uint32_t)ili9341_get_rotation() * 90U, 3);
+    put_text(&line, "  ", 0);
+    put_text(&line, g_cases[fn].name, 12);
+    put_size(&line, w, h);
+    put_u32(&line, calls, 6);
+    put_u32(&line, cycles / calls, 11);
+    put_u32(&line, kpx_s, 9);
+    put_u32(&line, bytes / calls - area * 2U, 7);
+    put_tenths(&line, ovh, 7);
+    out(line.text);
+}
+
+static void run_expand(bench_out_t out)
+{
+    surface_t surface;
+    uint8_t wire[SURFACE_CHUNK_PIXELS * 2];
+    const uint32_t rounds = 64;
+
+    surface_set_palette(&g_palette, g_expand_colors);
+    surface_init(&surface, g_row, SURFACE_CHUNK_PIXELS, 1, &g_palette);
+    for(uint32_t i = 0; i < sizeof(g_row); ++i) g_row[i] = (uint8_t)(i * 37U);
+
+    uint32_t start = perf_cycles();
+    for(uint32_t i = 0; i < rounds; ++i)
+    {
+        surface_expand(&surface, 0, 0, SURFACE_CHUNK_PIXELS, wire);
+    }
+    uint32_t cycles = perf_cycles() - start;
+
+    line_t line = { .len = 0 };
+    put_text(&line, "expand     surface_expand ", 0);
+    put_u32(&line, SURFACE_CHUNK_PIXELS, 0);
+    put_text(&line, " px: ", 0);
+    if(cycles)
+    {
+        put_tenths(&line, cycles * 10U / (rounds * SURFACE_CHUNK_PIXELS), 0);
+        put_text(&line, " cycles/pixel", 0);
+    }
+    else
+    {
+        put_text(&line, "CPU time is not simulated", 0);
+    }
+    out(line.text);
+}
+
+static void run_memory(bench_out_t out)
+{
+    const arena_stats_t *as = arena_get_stats();
+
+    line_t line = { .len = 0 };
+    put_text(&line, "memory     arena ", 0);
+    put_u32(&line, as->peak, 0);
+    put_text(&line, " of ", 0);
+    put_u32(&line, as->size, 0);
+    put_text(&line, " B peak, ", 0);
+    put_u32(&line, as->failures, 0);
+    put_text(&line, " failed; stack ", 0);
+    if(as->stack_size)
+    {
+        put_u32(&line, as->stack_peak, 0);
+        put_text(&line, " of ", 0);
+        put_u32(&line, as->stack_size, 0);
+        put_text(&line, " B peak", 0);
+    }
+    else
+    {
+        put_text(&line, "not measured", 0);
+    }
+    out(line.text);
+}
+
+void bench_run(uint32_t cycles_per_byte, bench_out_t out)
+{
+    const ili9341_rot_t entry_rotation = ili9341_get_rotation();
+    line_t line = { .len = 0 };
+
+    for(uint32_t i = 0; i < sizeof(g_data); ++i) g_data[i] = (uint8_t)(i * 29U);
+
+    put_text(&line, "bench      ", 0);
+    put_u32(&line, (uint32_t)PERF_CPU_HZ, 0);
+    put_text(&line, " Hz core, ", 0);
+    put_u32(&line, cycles_per_byte, 0);
+    put_text(&line, " cycles per SPI byte", 0);
+    out(line.text);
+    out("rot  function     size      calls   cyc/call    kpx/s  cmd B   ovh%");
+
+    for(uint32_t rot = ILI9341_ROT_0; rot <= ILI9341_ROT_270; ++rot)
+    {
+        ili9341_set_rotation((ili9341_rot_t)rot);
+
+        for(uint32_t fn = 0; fn < FN_COUNT; ++fn)
+        {
+            for(uint32_t shape = 0; shape < SHAPE_COUNT; ++shape)
+            {
+                if(g_cases[fn].shapes & SHAPE_BIT(shape))
+                {
+                    run_case((bench_fn_t)fn, (bench_shape_t)shape, cycles_per_byte, out);
+                }
+            }
+        }
+    }
+
+    ili9341_set_rotation(entry_rotation);
+
+    run_expand(out);
+    run_memory(out);
+}
+
+#ifdef HOST_BUILD
+static void vcp_line(const char *text)
+{
+    sim_vcp_write((const uint8_t *)text, (uint32_t)strlen(text));
+    sim_vcp_write((const uint8_t *)"\r\n", 2);
+}
+#else
+static void vcp_line(const char *text)
+{
+    while(*text)
+    {
+        while(!(BENCH_USART2_SR & BENCH_SR_TXE));
+        BENCH_USART2_DR = (uint8_t)*text++;
+    }
+    while(!(BENCH_USART2_SR & BENCH_SR_TXE));
+    BENCH_USART2_DR = '\r';
+    while(!(BENCH_USART2_SR & BENCH_SR_TXE));
+    BENCH_USART2_DR = '\n';
+}
+#endif
+
+void bench_play(void)
+{
+#ifndef HOST_BUILD
+    BENCH_RCC_AHB1ENR |= BENCH_AHB1ENR_GPIOA;
+    BENCH_RCC_APB1ENR |= BENCH_APB1ENR_USART2;
+    (void)BENCH_RCC_APB1ENR;
+
+    // PA2 to AF7
+    BENCH_GPIOA_MODER = (BENCH_GPIOA_MODER & ~(0x3UL << 4)) | (0x2UL << 4);
+    BENCH_GPIOA_AFRL = (BENCH_GPIOA_AFRL & ~(0xFUL << 8)) | (0x7UL << 8);
+
+    BENCH_USART2_CR1 = 0;
+    BENCH_USART2_BRR = (uint32_t)((BENCH_PCLK1_HZ + BENCH_BAUD / 2U) / BENCH_BAUD);
+    BENCH_USART2_CR3 = 0;
+    BENCH_USART2_CR1 = BENCH_CR1_UE | BENCH_CR1_TE;
+#endif
+
+    for(;;)
+    {
+        bench_run(ILI9341_CYCLES_PER_BYTE, vcp_line);
+        vcp_line("");
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+// Display primitive benchmark.
+//
+// Every drawing function in ili9341.h is run over the shapes the game
+// actually draws (single pixels, 5x5 balls, 3x48 paddles, full-width
+// lines and the full screen) in all four rotations, and timed with the
+// cycle counter. Each row of the report gives:
+//
+//   cyc/call  cycles per call
+//   kpx/s     pixels per second, in thousands
+//   cmd B     command and parameter bytes per call
+//   ovh%      share of the call not spent clocking pixel bytes out
+//
+// draw_sprite runs on the ball and paddle only, the shapes it exists for,
+// so it can be read against fill_rect on the same rows above it.
+//
+// The host build runs the same suite against the simulated SPI timing
+// and prints the same report, so the two can be compared line by line.
+// The report ends with the cost of surface_expand() per pixel, which is
+// CPU work only and so only measured on the board, and the arena and
+// stack peaks (arena.h).
+
+#define BENCH_PIXELS        (2UL * 320UL * 240UL)  // pixels drawn per case, roughly
+#define BENCH_MAX_CALLS     256
+#define BENCH_ROW_PIXELS    320                     // largest buffer sent in one call
+#define BENCH_LINE_CHARS    96
+
+#ifndef BENCH_BAUD
+#define BENCH_BAUD          115200UL
+#endif
+
+/**
+ * @brief Receives one report line, without the newline.
+ */
+typedef void (*bench_out_t)(const char *line);
+
+/**
+ * @brief Runs the whole suite and reports through out.
+ *
+ * The display must already be initialized. Leaves the screen in the
+ * rotation it found it in, but not its contents.
+ *
+ * @param cycles_per_byte Core cycles per SPI byte, used to split each
+ *                        call into pixel time and overhead.
+ * @param out             Line sink.
+ */
+void bench_run(uint32_t cycles_per_byte, bench_out_t out);
+
+/**
+ * @brief Runs the suite over and over, reporting on USART2 (the ST-LINK
+ *        virtual COM port) at BENCH_BAUD.
+ */
+void bench_play(void);
+
+#endif
@@ -0,0 +1,71 @@
+#include "arena.h"
+
+#include <stddef.h>
+
+#ifdef HOST_BUILD
+static uint64_t g_arena[ARENA_SIZE / sizeof(uint64_t)];   // ARENA_ALIGN aligned
+#define ARENA_START ((uint8_t *)g_arena)
+#define ARENA_END   ((uint8_t *)g_arena + ARENA_SIZE)
+#else
+// link.ld
+extern uint8_t _sarena[];
+extern uint8_t _earena[];
+extern uint32_t _end[];
+extern uint32_t _estack[];
+#define ARENA_START ((uint8_t *)_sarena)
+#define ARENA_END   ((uint8_t *)_earena)
+#endif
+
+static uint32_t g_used;
+static arena_stats_t g_stats;
+
+
+void *arena_alloc(uint32_t bytes)
+{
+    const uint32_t size = (uint32_t)(ARENA_END - ARENA_START);
+    uint32_t need = (bytes + ARENA_ALIGN - 1U) & ~(ARENA_ALIGN - 1U);
+
+    if(need < bytes || need > size - g_used)
+    {
+        g_stats.failures++;
+        return NULL;
+    }
+
+    void *block = ARENA_START + g_used;
+    g_used += need;
+    if(g_used > g_stats.peak) g_stats.peak = g_used;
+
+    return block;
+}
+
+void arena_frame_reset(void)
+{
+    g_used = 0;
+}
+
+arena_mark_t arena_mark(void)
+{
+    return g_used;
+}
+
+void arena_release(arena_mark_t mark)
+{
+    if(mark < g_used) g_used = mark;
+}
+
+const arena_stats_t *arena_get_stats(void)
+{
+    g_stats.size = (uint32_t)(ARENA_END - ARENA_START);
+    g_stats.used = g_used;
+
+#ifndef HOST_BUILD
+    // Lowest word the stack has written over
+    const uint32_t *p = _end;
+    while(p < _estack && *p == ARENA_STACK_PAINT) ++p;
+
+    g_stats.stack_size = (uint32_t)((uint8_t *)_estack - (uint8_t *)_end);
+    g_stats.stack_peak = (uint32_t)((uint8_t *)_estack - (uint8_t *)p);
+#endif
+
+    return &g_stats;
+}
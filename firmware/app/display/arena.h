@@ -0,0 +1,83 @@
+#ifndef DISPLAY_ARENA_H
+#define DISPLAY_ARENA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Scratch memory for the renderer, and stack high-water tracking.
+//
+// The arena is a RAM region of ARENA_SIZE bytes reserved by link.ld after
+// .bss. Allocation bumps a pointer; nothing is freed on its own. Two
+// lifetimes:
+//   - frame: arena_alloc() memory lasts until arena_frame_reset(), which
+//     the game loops call once per tick
+//   - scoped: arena_mark() before and arena_release() after hands back
+//     everything allocated in between, for buffers inside one call
+//
+// A request that does not fit returns NULL and is counted, so callers
+// need a slower path that does without, and the peak shows how close
+// the game comes to the limit.
+//
+// The startup code paints the RAM between the end of the arena and the
+// top of the stack with ARENA_STACK_PAINT before main(). The deepest
+// point the stack has reached is the lowest word no longer painted.
+//
+// `make mem` gives the link-time side: the reserved sizes, the RAM left
+// for the stack and the largest stack frames (-fstack-usage).
+
+// The host tools share one build, so their arena takes the largest
+// figure, the batched multi-ball build's (link.ld, Makefile).
+#ifdef HOST_BUILD
+#ifndef ARENA_SIZE
+#define ARENA_SIZE          (18U * 1024U)   // BALLS_ARENA_BYTES(BALLS_MAX)
+#endif
+#endif
+
+#define ARENA_ALIGN         8U
+#define ARENA_STACK_PAINT   0xC5C5C5C5UL    // must match startup.s
+
+typedef uint32_t arena_mark_t;
+
+typedef struct
+{
+    uint32_t size;          // arena bytes
+    uint32_t used;
+    uint32_t peak;          // most ever in use at once
+    uint32_t failures;      // requests that did not fit
+
+    uint32_t stack_size;    // RAM between the arena and the top of RAM
+    uint32_t stack_peak;    // deepest the stack has been; 0 on the host
+} arena_stats_t;
+
+/**
+ * @brief Allocates scratch memory, ARENA_ALIGN aligned, valid until
+ *        arena_frame_reset() or an arena_release() to an earlier mark.
+ *
+ * @param bytes Size of the block.
+ * @return The block, or NULL if the arena is full.
+ */
+void *arena_alloc(uint32_t bytes);
+
+/**
+ * @brief Frees everything; call at the start of each frame.
+ */
+void arena_frame_reset(void);
+
+/**
+ * @brief Returns the current fill level, for arena_release().
+ */
+arena_mark_t arena_mark(void);
+
+/**
+ * @brief Frees everything allocated since the mark was taken.
+ */
+void arena_release(arena_mark_t mark);
+
+/**
+ * @brief Returns the arena counters and the stack high-water mark.
+ *
+ * Scans the painted stack area, so call it for reports, not per frame.
+ */
+const arena_stats_t *arena_get_stats(void);
+
+#endif
@@ -1,5 +1,15 @@
 #include "ili9341.h"
 
+#include <stddef.h>
+
+#ifdef ILI9341_MIRROR
+#include "mirror.h"
+#endif
+
+#ifdef ILI9341_SPI_QUEUE
+#include "spiq.h"
+#endif
+
 // Driver state
 typedef struct
 {
@@ -9,20 +19,69 @@ typedef struct
     uint8_t pixel_format;
     bool invert;
     uint8_t madctl;
+    uint32_t tx_bytes;
+    uint16_t scroll_head;
+    uint16_t scroll_tail;
+    uint16_t scroll_offset;
+#ifdef ILI9341_MIRROR
+    uint16_t win_x, win_y, win_w, win_h;
+#endif
 
 } ili9341_context_t;
 
 static ili9341_context_t g_context;
+static uint8_t g_fill[ILI9341_FILL_BATCH * 2U];    // send_fill() pixels
 
 // Helpers
-static inline void CS_LOW(void)   { gpio_write_pin(ILI9341_CONTROL_PORT, ILI9341_CS_PIN, 0);  }
-static inline void CS_HIGH(void)  { gpio_write_pin(ILI9341_CONTROL_PORT, ILI9341_CS_PIN, 1);  }
-static inline void DC_LOW(void)   { gpio_write_pin(ILI9341_CONTROL_PORT, ILI9341_DC_PIN, 0);  }
-static inline void DC_HIGH(void)  { gpio_write_pin(ILI9341_CONTROL_PORT, ILI9341_DC_PIN, 1);  }
+static inline void SPI_WAIT_IDLE(void) { while(spi_flag_status(ILI9341_SPI_PERIPHERAL, SPI_FLAG_BUSY)); }
+
+// CS and DC must hold until the last byte sent is out of the shifter, so
+// changing them waits for BSY, whether or not spi_send() already did
+static inline void CS_LOW(void)   { SPI_WAIT_IDLE(); gpio_write_pin(ILI9341_CONTROL_PORT, ILI9341_CS_PIN, 0); }
+static inline void CS_HIGH(void)  { SPI_WAIT_IDLE(); gpio_write_pin(ILI9341_CONTROL_PORT, ILI9341_CS_PIN, 1); }
+static inline void DC_LOW(void)   { SPI_WAIT_IDLE(); gpio_write_pin(ILI9341_CONTROL_PORT, ILI9341_DC_PIN, 0); }
+static inline void DC_HIGH(void)  { SPI_WAIT_IDLE(); gpio_write_pin(ILI9341_CONTROL_PORT, ILI9341_DC_PIN, 1); }
 static inline void RST_LOW(void)  { gpio_write_pin(ILI9341_CONTROL_PORT, ILI9341_RST_PIN, 0); }
 static inline void RST_HIGH(void) { gpio_write_pin(ILI9341_CONTROL_PORT, ILI9341_RST_PIN, 1); }
+#ifdef HOST_BUILD
+static inline void BARRIER(void)  { __asm volatile ("" ::: "memory"); }
+#else
 static inline void BARRIER(void)  { __asm volatile ("dsb"); }
-static inline void SPI_WAIT_IDLE(void) { while(spi_flag_status(ILI9341_SPI_PERIPHERAL, SPI_FLAG_BUSY)); }
+#endif
+
+static inline void SPI_TX(const uint8_t *data, uint32_t len)
+{
+    g_context.tx_bytes += len;
+    spi_send(ILI9341_SPI_PERIPHERAL, data, len);
+}
+
+// Short transfers go through the interrupt-driven queue once it runs;
+// anything sent from the CPU has to wait for it to drain first
+#ifdef ILI9341_SPI_QUEUE
+static inline void FENCE(void) { spiq_fence(); }
+#else
+static inline void FENCE(void) { }
+#endif
+
+// Copies of memory writes for the host viewer
+#ifdef ILI9341_MIRROR
+static inline void MIRROR_SCREEN(void) { mirror_screen(g_context.width, g_context.height); }
+static inline void MIRROR_BEGIN(void)  { mirror_begin(g_context.win_x, g_context.win_y, g_context.win_w, g_context.win_h); }
+static inline void MIRROR_DATA(const uint8_t *data, uint32_t len) { mirror_data(data, len); }
+static inline void MIRROR_FILL(uint16_t color, uint32_t count)    { mirror_fill(color, count); }
+static inline void MIRROR_END(void)    { mirror_end(); }
+static inline void MIRROR_SCROLL(void)
+{
+    mirror_scroll(g_context.scroll_head, g_context.scroll_tail, g_context.scroll_offset);
+}
+#else
+static inline void MIRROR_SCREEN(void) { }
+static inline void MIRROR_BEGIN(void)  { }
+static inline void MIRROR_DATA(const uint8_t *data, uint32_t len) { (void)data; (void)len; }
+static inline void MIRROR_FILL(uint16_t color, uint32_t count)    { (void)color; (void)count; }
+static inline void MIRROR_END(void)    { }
+static inline void MIRROR_SCROLL(void) { }
+#endif
 
 
 static void update_dims_from_rotation(void)
@@ -39,17 +98,45 @@ static void update_dims_from_rotation(void)
     }
 }
 
+#ifdef ILI9341_SPI_QUEUE
+// Queues a command and its parameters with the chip already selected
+static void queue_in_burst(uint8_t cmd, const uint8_t *data, uint32_t data_bytes)
+{
+    g_context.tx_bytes += 1U + data_bytes;
+
+    spiq_dc(false);
+    spiq_bytes(&cmd, 1);
+    if(!data_bytes) return;
+
+    spiq_dc(true);
+    spiq_bytes(data, data_bytes);
+}
+
+static void queue_cmd_data(uint8_t cmd, const uint8_t *data, uint32_t data_bytes)
+{
+    spiq_cs(false);
+    queue_in_burst(cmd, data, data_bytes);
+    spiq_cs(true);
+}
+#endif
+
 static void ili9341_send_cmd(uint8_t cmd)
 {
+#ifdef ILI9341_SPI_QUEUE
+    if(spiq_active())
+    {
+        queue_cmd_data(cmd, NULL, 0);
+        return;
+    }
+#endif
+
     // Interpret as command
     DC_LOW(); BARRIER();
 
     // Start SPI communication
     CS_LOW(); BARRIER();
 
-    spi_send(ILI9341_SPI_PERIPHERAL, &cmd, 1);
-
-    SPI_WAIT_IDLE();
+    SPI_TX(&cmd, 1);
 
     // End SPI communication
     CS_HIGH(); BARRIER();
@@ -57,41 +144,47 @@ static void ili9341_send_cmd(uint8_t cmd)
 
 static void ili9341_send_cmd_data(uint8_t cmd, const uint8_t *data, uint32_t data_bytes)
 {
+#ifdef ILI9341_SPI_QUEUE
+    if(spiq_active())
+    {
+        queue_cmd_data(cmd, data, data_bytes);
+        return;
+    }
+#endif
+
     // Interpret as command
     DC_LOW(); BARRIER();
 
     // Start SPI communication
     CS_LOW(); BARRIER();
 
-    spi_send(ILI9341_SPI_PERIPHERAL, &cmd, 1);
-
-    SPI_WAIT_IDLE();
+    SPI_TX(&cmd, 1);
 
     // Interpret as parameters
     DC_HIGH(); BARRIER();
 
     while(data_bytes--)
     {
-        spi_send(ILI9341_SPI_PERIPHERAL, data++, 1);
+        SPI_TX(data++, 1);
     }
 
-    SPI_WAIT_IDLE();
-
     // End SPI communication
     CS_HIGH(); BARRIER();
 }
 
 static void ili9341_start_stream(void)
 {
+    FENCE();
+
     DC_LOW(); BARRIER();
     CS_LOW(); BARRIER();
 
     uint8_t cmd = ILI9341_CMD_MEMORY_WRITE;
-    spi_send(ILI9341_SPI_PERIPHERAL, &cmd, 1);
-
-    SPI_WAIT_IDLE();
+    SPI_TX(&cmd, 1);
 
     DC_HIGH(); BARRIER();
+
+    MIRROR_BEGIN();
 }
 
 static void ili9341_write_pixels(uint16_t *colors, uint32_t count)
@@ -100,17 +193,44 @@ static void ili9341_write_pixels(uint16_t *colors, uint32_t count)
     {
         uint8_t hi = (uint8_t)((*colors) >> 8);
         uint8_t lo = (uint8_t)((*colors) & 0xFF);
-        spi_send(ILI9341_SPI_PERIPHERAL, &hi, 1);
-        spi_send(ILI9341_SPI_PERIPHERAL, &lo, 1);
+        SPI_TX(&hi, 1);
+        SPI_TX(&lo, 1);
+        MIRROR_FILL(*colors, 1);
         ++colors;
     }
-    SPI_WAIT_IDLE();
+}
+
+// Streams total pixels of one color, ILI9341_FILL_BATCH per SPI call
+static void send_fill(uint16_t color, uint32_t total)
+{
+    ili9341_fill_pixels(g_fill, color, ILI9341_FILL_BATCH);
+    MIRROR_FILL(color, total);
+
+    while(total)
+    {
+        uint32_t chunk = (total > ILI9341_FILL_BATCH) ? ILI9341_FILL_BATCH : total;
+        SPI_TX(g_fill, chunk * 2U);
+        total -= chunk;
+    }
 }
 
 static void ili9341_end_stream(void)
 {
-    SPI_WAIT_IDLE();
     CS_HIGH(); BARRIER();
+
+    MIRROR_END();
+}
+
+// Sends a command and its parameters with the chip already selected
+static void send_in_burst(const uint8_t *cmd, const uint8_t *data, uint32_t data_bytes)
+{
+    DC_LOW(); BARRIER();
+
+    SPI_TX(cmd, 1);
+
+    DC_HIGH(); BARRIER();
+
+    SPI_TX(data, data_bytes);
 }
 
 static void ili9341_set_column(uint16_t x0, uint16_t x1)
@@ -131,6 +251,40 @@ static void ili9341_set_page(uint16_t y0, uint16_t y1)
     ili9341_send_cmd_data(ILI9341_CMD_PAGE_ADDR, p, 4);
 }
 
+// The scroll registers count panel rows, which run against the screen
+// axis when MADCTL mirrors it (MY, or MX with MV)
+static bool scroll_reversed(void)
+{
+    return g_context.rotation == ILI9341_ROT_180 || g_context.rotation == ILI9341_ROT_270;
+}
+
+static void send_scroll_area(void)
+{
+    uint16_t lines = (uint16_t)(ILI9341_TFTHEIGHT - g_context.scroll_head - g_context.scroll_tail);
+    uint16_t top = scroll_reversed() ? g_context.scroll_tail : g_context.scroll_head;
+    uint16_t bottom = scroll_reversed() ? g_context.scroll_head : g_context.scroll_tail;
+    uint8_t p[6] = {
+        (uint8_t)(top >> 8), (uint8_t)(top & 0xFF),
+        (uint8_t)(lines >> 8), (uint8_t)(lines & 0xFF),
+        (uint8_t)(bottom >> 8), (uint8_t)(bottom & 0xFF)
+    };
+    ili9341_send_cmd_data(ILI9341_CMD_VERT_SCROLL_DEF, p, 6);
+}
+
+static void send_scroll_start(void)
+{
+    uint16_t lines = (uint16_t)(ILI9341_TFTHEIGHT - g_context.scroll_head - g_context.scroll_tail);
+    uint16_t top = scroll_reversed() ? g_context.scroll_tail : g_context.scroll_head;
+    uint16_t shift = (uint16_t)(g_context.scroll_offset % lines);
+
+    // Panel rows run backwards: scroll the other way round the ring
+    if(scroll_reversed() && shift) shift = (uint16_t)(lines - shift);
+
+    uint16_t start = (uint16_t)(top + shift);
+    uint8_t p[2] = { (uint8_t)(start >> 8), (uint8_t)(start & 0xFF) };
+    ili9341_send_cmd_data(ILI9341_CMD_VERT_SCROLL_ADDR, p, 2);
+}
+
 static uint8_t rotation_to_madctl(ili9341_rot_t r)
 {
     switch(r)
@@ -145,6 +299,8 @@ static uint8_t rotation_to_madctl(ili9341_rot_t r)
 
 void ili9341_hardware_reset(bool worst_case)
 {
+    FENCE();
+
     CS_HIGH();
     DC_HIGH();
 
@@ -160,6 +316,7 @@ void ili9341_hardware_reset(bool worst_case)
 void ili9341_software_reset()
 {
     ili9341_send_cmd(ILI9341_CMD_SOFTWARE_RESET);
+    FENCE();
 
     dwt_delay_ms(10U);
 }
@@ -173,6 +330,9 @@ void ili9341_init(const ili9341_config_t *config)
     g_context.width = ILI9341_TFTWIDTH;
     g_context.height = ILI9341_TFTHEIGHT;
     g_context.invert = false;
+    g_context.scroll_head = 0;
+    g_context.scroll_tail = 0;
+    g_context.scroll_offset = 0;
 
     if(config)
     {
@@ -196,6 +356,7 @@ void ili9341_init(const ili9341_config_t *config)
 
     g_context.madctl = rotation_to_madctl(g_context.rotation);
     ili9341_send_cmd_data(ILI9341_CMD_MEMORY_ACCESS, &g_context.madctl, 1);
+    MIRROR_SCREEN();
 
     if(g_context.invert) ili9341_send_cmd(ILI9341_CMD_DISPLAY_INV_ON);
     else                 ili9341_send_cmd(ILI9341_CMD_DISPLAY_INV_OFF);
@@ -209,6 +370,12 @@ void ili9341_set_rotation(ili9341_rot_t rotation)
     update_dims_from_rotation();
     g_context.madctl = rotation_to_madctl(rotation);
     ili9341_send_cmd_data(ILI9341_CMD_MEMORY_ACCESS, &g_context.madctl, 1);
+    MIRROR_SCREEN();
+
+    if(g_context.scroll_head || g_context.scroll_tail || g_context.scroll_offset)
+    {
+        ili9341_set_scroll_area(0, 0);
+    }
 }
 
 ili9341_rot_t ili9341_get_rotation(void)
@@ -222,6 +389,11 @@ void ili9341_get_screen_size(uint16_t *width, uint16_t *height)
     *height = g_context.height;
 }
 
+uint32_t ili9341_get_tx_bytes(void)
+{
+    return g_context.tx_bytes;
+}
+
 void ili9341_set_invert(bool enable)
 {
     if(enable) ili9341_send_cmd(ILI9341_CMD_DISPLAY_INV_ON);
@@ -233,33 +405,80 @@ void ili9341_set_invert(bool enable)
 void ili9341_display_on(void)
 {
     ili9341_send_cmd(ILI9341_CMD_DISPLAY_ON);
+    FENCE();
     dwt_delay_ms(10);
 }
 
 void ili9341_display_off(void)
 {
     ili9341_send_cmd(ILI9341_CMD_DISPLAY_OFF);
+    FENCE();
     dwt_delay_ms(10);
 }
 
 void ili9341_sleep_in(void)
 {
     ili9341_send_cmd(ILI9341_CMD_SLEEP_IN);
+    FENCE();
     dwt_delay_ms(120);
 }
 
 void ili9341_sleep_out(void)
 {
     ili9341_send_cmd(ILI9341_CMD_SLEEP_OUT);
+    FENCE();
     dwt_delay_ms(120);
 }
 
+void ili9341_set_scroll_area(uint16_t head, uint16_t tail)
+{
+    if(head + tail >= ILI9341_TFTHEIGHT) return;
+
+    g_context.scroll_head = head;
+    g_context.scroll_tail = tail;
+    g_context.scroll_offset = 0;
+
+    send_scroll_area();
+    send_scroll_start();
+    MIRROR_SCROLL();
+}
+
+void ili9341_set_scroll(uint16_t offset)
+{
+    g_context.scroll_offset = offset;
+
+    send_scroll_start();
+    MIRROR_SCROLL();
+}
+
+bool ili9341_scroll_horizontal(void)
+{
+    return g_context.rotation == ILI9341_ROT_90 || g_context.rotation == ILI9341_ROT_270;
+}
+
+uint16_t ili9341_scroll_line(uint16_t pos)
+{
+    uint16_t head = g_context.scroll_head;
+    uint16_t lines = (uint16_t)(ILI9341_TFTHEIGHT - head - g_context.scroll_tail);
+
+    if(pos < head || pos >= head + lines) return pos;
+
+    return (uint16_t)(head + (pos - head + g_context.scroll_offset % lines) % lines);
+}
+
 void ili9341_set_addr_window(uint16_t x, uint16_t y, uint16_t w, uint16_t h)
 {
     uint16_t x1 = (uint16_t)(x + w - 1U);
     uint16_t y1 = (uint16_t)(y + h - 1U);
     ili9341_set_column(x, x1);
     ili9341_set_page(y, y1);
+
+#ifdef ILI9341_MIRROR
+    g_context.win_x = x;
+    g_context.win_y = y;
+    g_context.win_w = w;
+    g_context.win_h = h;
+#endif
 }
 
 void ili9341_draw_pixel(uint16_t x, uint16_t y, uint16_t color)
@@ -275,30 +494,37 @@ void ili9341_fill_rect(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t
 {
     ili9341_set_addr_window(x, y, w, h);
 
+    ili9341_start_stream();
+    send_fill(color, (uint32_t)w * (uint32_t)h);
+    ili9341_end_stream();
+}
+
+void ili9341_draw_buffer(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint8_t *data)
+{
+    ili9341_set_addr_window(x, y, w, h);
+
     ili9341_start_stream();
 
-    uint8_t hi = (uint8_t)(color >> 8);
-    uint8_t lo = (uint8_t)color;
-    const uint32_t total = (uint32_t)w * (uint32_t)h;
-    const uint32_t BATCH_PIXELS = 64;
-    uint8_t buffer[BATCH_PIXELS * 2];
+    SPI_TX(data, (uint32_t)w * (uint32_t)h * 2U);
+    MIRROR_DATA(data, (uint32_t)w * (uint32_t)h * 2U);
+    ili9341_end_stream();
+}
 
-    for(uint32_t i = 0; i < BATCH_PIXELS; ++i)
-    {
-        buffer[2*i + 0] = hi;
-        buffer[2*i + 1] = lo;
-    }
+void ili9341_begin_write(uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+    ili9341_set_addr_window(x, y, w, h);
 
-    uint32_t remaining = total;
+    ili9341_start_stream();
+}
 
-    while(remaining)
-    {
-        uint32_t chunk = (remaining > BATCH_PIXELS) ? BATCH_PIXELS : remaining;
-        spi_send(ILI9341_SPI_PERIPHERAL, buffer, chunk * 2U);
-        remaining -= chunk;
-    }
+void ili9341_write_data(const uint8_t *data, uint32_t bytes)
+{
+    SPI_TX(data, bytes);
+    MIRROR_DATA(data, bytes);
+}
 
-    SPI_WAIT_IDLE();
+void ili9341_end_write(void)
+{
     ili9341_end_stream();
 }
 
@@ -335,29 +561,68 @@ void ili9341_fill_screen(uint16_t color)
     ili9341_set_addr_window(0, 0, g_context.width, g_context.height);
 
     ili9341_start_stream();
+    send_fill(color, ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT);
+    ili9341_end_stream();
+}
 
-    uint8_t hi = (uint8_t)(color >> 8);
-    uint8_t lo = (uint8_t)color;
-    const uint32_t total = ILI9341_TFTWIDTH * ILI9341_TFTHEIGHT;
-    const uint32_t BATCH_PIXELS = 64;
-    uint8_t buffer[BATCH_PIXELS * 2];
-
-    for(uint32_t i = 0; i < BATCH_PIXELS; ++i)
+void ili9341_fill_pixels(uint8_t *pixels, uint16_t color, uint32_t count)
+{
+    while(count--)
     {
-        buffer[2*i + 0] = hi;
-        buffer[2*i + 1] = lo;
+        *pixels++ = (uint8_t)(color >> 8);
+        *pixels++ = (uint8_t)color;
     }
+}
 
-    uint32_t remaining = total;
-
-    while(remaining)
+void ili9341_draw_sprite(ili9341_sprite_t *sprite, uint16_t x, uint16_t y)
+{
+    uint8_t *p = sprite->header;
+    uint16_t x1 = (uint16_t)(x + sprite->w_1);
+    uint16_t y1 = (uint16_t)(y + sprite->h_1);
+
+    p[ILI9341_SPRITE_CASET + 1] = (uint8_t)(x >> 8);
+    p[ILI9341_SPRITE_CASET + 2] = (uint8_t)x;
+    p[ILI9341_SPRITE_CASET + 3] = (uint8_t)(x1 >> 8);
+    p[ILI9341_SPRITE_CASET + 4] = (uint8_t)x1;
+    p[ILI9341_SPRITE_PASET + 1] = (uint8_t)(y >> 8);
+    p[ILI9341_SPRITE_PASET + 2] = (uint8_t)y;
+    p[ILI9341_SPRITE_PASET + 3] = (uint8_t)(y1 >> 8);
+    p[ILI9341_SPRITE_PASET + 4] = (uint8_t)y1;
+
+#ifdef ILI9341_MIRROR
+    g_context.win_x = x;
+    g_context.win_y = y;
+    g_context.win_w = (uint16_t)(sprite->w_1 + 1U);
+    g_context.win_h = (uint16_t)(sprite->h_1 + 1U);
+#endif
+
+#ifdef ILI9341_SPI_QUEUE
+    if(spiq_active())
     {
-        uint32_t chunk = (remaining > BATCH_PIXELS) ? BATCH_PIXELS : remaining;
-        spi_send(ILI9341_SPI_PERIPHERAL, buffer, chunk * 2U);
-        remaining -= chunk;
+        // The header is copied, as the next draw patches it; the pixels
+        // go out in place
+        spiq_cs(false);
+        queue_in_burst(p[ILI9341_SPRITE_CASET], &p[ILI9341_SPRITE_CASET + 1], 4);
+        queue_in_burst(p[ILI9341_SPRITE_PASET], &p[ILI9341_SPRITE_PASET + 1], 4);
+        queue_in_burst(p[ILI9341_SPRITE_RAMWR], NULL, 0);
+        g_context.tx_bytes += sprite->bytes;
+        spiq_dc(true);
+        spiq_block(sprite->pixels, sprite->bytes);
+        spiq_cs(true);
     }
+    else
+#endif
+    {
+        CS_LOW(); BARRIER();
 
-    SPI_WAIT_IDLE();
+        send_in_burst(&p[ILI9341_SPRITE_CASET], &p[ILI9341_SPRITE_CASET + 1], 4);
+        send_in_burst(&p[ILI9341_SPRITE_PASET], &p[ILI9341_SPRITE_PASET + 1], 4);
+        send_in_burst(&p[ILI9341_SPRITE_RAMWR], sprite->pixels, sprite->bytes);
 
-    CS_HIGH(); BARRIER();
+        CS_HIGH(); BARRIER();
+    }
+
+    MIRROR_BEGIN();
+    MIRROR_DATA(sprite->pixels, sprite->bytes);
+    MIRROR_END();
 }
@@ -18,11 +18,21 @@
 #define ILI9341_CS_PIN          GPIO_PIN_5
 #define ILI9341_DC_PIN          GPIO_PIN_6
 #define ILI9341_RST_PIN         GPIO_PIN_7
+
+// Interrupt of the SPI peripheral, for the command queue (spiq.h)
+#define ILI9341_SPI_IRQ         36U
+#define ILI9341_SPI_HANDLER     SPI2_Handler
 // ===============================================================
 
 #define ILI9341_TFTWIDTH   240
 #define ILI9341_TFTHEIGHT  320
 
+// Core cycles per byte on the wire (SPI_BAUD_DIV2 on APB1 = HCLK)
+#define ILI9341_CYCLES_PER_BYTE 16U
+
+// Pixels per SPI call in solid fills, from a static buffer in the driver
+#define ILI9341_FILL_BATCH      64U
+
 typedef enum ili9341_rot_t
 {
     ILI9341_ROT_0 = 0, // portrait
@@ -67,6 +77,7 @@ typedef struct
 #define ILI9341_CMD_TEARING_OFF      0x34
 #define ILI9341_CMD_TEARING_ON       0x35
 #define ILI9341_CMD_MEMORY_ACCESS    0x36
+#define ILI9341_CMD_VERT_SCROLL_ADDR 0x37
 #define ILI9341_CMD_PIXEL_FORMAT     0x3A
 
 #define ILI9341_CMD_FRAME_RATE_CTRL1 0xB1
@@ -93,6 +104,35 @@ typedef struct
 #define ILI9341_CMD_POS_GAMMA        0xE0
 #define ILI9341_CMD_NEG_GAMMA        0xE1
 
+// Sprite packets: the CASET, PASET and RAMWR commands for a fixed-size
+// window, laid out at compile time by ILI9341_SPRITE(). A draw patches
+// the eight coordinate bytes and sends the lot, pixels included, inside
+// one chip select.
+#define ILI9341_SPRITE_CASET    0   // command, x0 (2), x1 (2)
+#define ILI9341_SPRITE_PASET    5   // command, y0 (2), y1 (2)
+#define ILI9341_SPRITE_RAMWR    10
+#define ILI9341_SPRITE_HEADER   11
+
+#define ILI9341_SPRITE_BYTES(w, h) ((uint32_t)(w) * (uint32_t)(h) * 2U)
+
+typedef struct
+{
+    uint8_t header[ILI9341_SPRITE_HEADER];
+    uint16_t w_1;           // width - 1
+    uint16_t h_1;           // height - 1
+    uint32_t bytes;         // pixel bytes
+    const uint8_t *pixels;  // RGB565, big-endian, row by row
+} ili9341_sprite_t;
+
+#define ILI9341_SPRITE(w, h, pixels)                                        \
+    {                                                                       \
+        { ILI9341_CMD_COLUMN_ADDR, 0, 0, 0, 0,                              \
+          ILI9341_CMD_PAGE_ADDR, 0, 0, 0, 0,                                \
+          ILI9341_CMD_MEMORY_WRITE },                                       \
+        (uint16_t)((w) - 1U), (uint16_t)((h) - 1U),                         \
+        ILI9341_SPRITE_BYTES(w, h), (pixels)                                \
+    }
+
 // MADCTL values
 #define MADCTL_MY  0x80
 #define MADCTL_MX  0x40
@@ -153,6 +193,8 @@ void ili9341_software_reset(void);
  * Updates internal state, recalculates dimensions, and writes
  * the corresponding MADCTL register value.
  *
+ * Also ends any scrolling set up with ili9341_set_scroll_area().
+ *
  * @param rotation Desired rotation (0, 90, 180, 270 degrees).
  */
 void ili9341_set_rotation(ili9341_rot_t rotation);
@@ -166,6 +208,15 @@ ili9341_rot_t ili9341_get_rotation(void);
 
 void ili9341_get_screen_size(uint16_t *width, uint16_t *height);
 
+/**
+ * @brief Gets the number of bytes sent to the display so far.
+ *
+ * Counts commands, parameters and pixel data. Wraps at 2^32.
+ *
+ * @return Bytes sent since power-up.
+ */
+uint32_t ili9341_get_tx_bytes(void);
+
 /**
  * @brief Enables or disables display color inversion.
  *
@@ -202,6 +253,44 @@ void ili9341_sleep_in(void);
  */
 void ili9341_sleep_out(void);
 
+/**
+ * @brief Splits the scroll axis into a fixed head, a scrolling area and a
+ *        fixed tail.
+ *
+ * The panel scrolls along its 320-pixel side: y in the portrait rotations
+ * and x in the landscape ones. Head and tail are counted in screen
+ * coordinates along that axis, so the head is always at the low end
+ * whatever the rotation. Resets the scroll offset to 0.
+ *
+ * @param head Fixed lines at the start of the axis.
+ * @param tail Fixed lines at the end of the axis; head + tail < 320.
+ */
+void ili9341_set_scroll_area(uint16_t head, uint16_t tail);
+
+/**
+ * @brief Scrolls the area set by ili9341_set_scroll_area().
+ *
+ * Screen line p of the scrolling area shows the line written at
+ * head + (p - head + offset) mod (320 - head - tail), so a growing offset
+ * moves the picture towards the start of the axis and brings in lines
+ * from the far end. Drawing calls keep writing to unscrolled
+ * coordinates; see ili9341_scroll_line().
+ *
+ * @param offset Lines to scroll by.
+ */
+void ili9341_set_scroll(uint16_t offset);
+
+/**
+ * @brief Returns true when the scroll axis is x (landscape rotations).
+ */
+bool ili9341_scroll_horizontal(void);
+
+/**
+ * @brief Returns the drawing coordinate, along the scroll axis, of the
+ *        line currently shown at screen position pos.
+ */
+uint16_t ili9341_scroll_line(uint16_t pos);
+
 /**
  * @brief Defines the active drawing window.
  *
@@ -235,6 +324,43 @@ void ili9341_draw_pixel(uint16_t x, uint16_t y, uint16_t color);
  */
 void ili9341_fill_rect(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t color);
 
+/**
+ * @brief Draws a block of pixels in a single window.
+ *
+ * @param x X-coordinate of the top-left corner.
+ * @param y Y-coordinate of the top-left corner.
+ * @param w Width of the block in pixels.
+ * @param h Height of the block in pixels.
+ * @param data w * h RGB565 pixels, row by row, high byte first.
+ */
+void ili9341_draw_buffer(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const uint8_t *data);
+
+/**
+ * @brief Opens a window and starts a pixel stream into it.
+ *
+ * Pixel data is then sent with ili9341_write_data() in as many pieces as
+ * needed, and the stream is closed with ili9341_end_write().
+ *
+ * @param x X-coordinate of the top-left corner.
+ * @param y Y-coordinate of the top-left corner.
+ * @param w Width of the window in pixels.
+ * @param h Height of the window in pixels.
+ */
+void ili9341_begin_write(uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+
+/**
+ * @brief Sends pixel data into the stream opened by ili9341_begin_write().
+ *
+ * @param data  RGB565 pixels, high byte first.
+ * @param bytes Number of bytes (twice the pixel count).
+ */
+void ili9341_write_data(const uint8_t *data, uint32_t bytes);
+
+/**
+ * @brief Closes the stream opened by ili9341_begin_write().
+ */
+void ili9341_end_write(void);
+
 /**
  * @brief Draws a horizontal line.
  *
@@ -262,4 +388,27 @@ void ili9341_draw_vline(uint16_t x, uint16_t y, uint16_t h, uint16_t color);
  */
 void ili9341_fill_screen(uint16_t color);
 
+/**
+ * @brief Writes a color into a pixel buffer in wire order, for sprites.
+ *
+ * @param pixels Buffer of 2 * count bytes.
+ * @param color  16-bit RGB565 color value.
+ * @param count  Number of pixels.
+ */
+void ili9341_fill_pixels(uint8_t *pixels, uint16_t color, uint32_t count);
+
+/**
+ * @brief Draws a sprite with its top-left corner at (x, y).
+ *
+ * Same result as ili9341_draw_buffer() with the sprite's size and pixels,
+ * but the commands go out from the prepared packet in one chip select.
+ * With the SPI queue running (spiq.h) the call returns before the pixels
+ * are sent, so they must not change until spiq_fence().
+ *
+ * @param sprite Sprite made with ILI9341_SPRITE(); its header is patched.
+ * @param x      X-coordinate.
+ * @param y      Y-coordinate.
+ */
+void ili9341_draw_sprite(ili9341_sprite_t *sprite, uint16_t x, uint16_t y);
+
 #endif
\ No newline at end of file
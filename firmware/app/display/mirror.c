@@ -0,0 +1,495 @@
+#include "mirror.h"
+
+#include <string.h>
+
+#ifdef HOST_BUILD
+#include "sim.h"
+
+// UART time per byte: start, 8 data and stop bits
+#define MIRROR_CYCLES_PER_BYTE  ((uint64_t)SIM_CPU_HZ * 10U / MIRROR_BAUD)
+#else
+#define MIRROR_RCC_AHB1ENR      (*(volatile uint32_t *)0x40023830UL)
+#define MIRROR_RCC_APB1ENR      (*(volatile uint32_t *)0x40023840UL)
+#define MIRROR_GPIOA_MODER      (*(volatile uint32_t *)0x40020000UL)
+#define MIRROR_GPIOA_AFRL       (*(volatile uint32_t *)0x40020020UL)
+#define MIRROR_USART2_BASE      0x40004400UL
+#define MIRROR_USART2_SR        (*(volatile uint32_t *)(MIRROR_USART2_BASE + 0x00UL))
+#define MIRROR_USART2_DR_ADDR   (MIRROR_USART2_BASE + 0x04UL)
+#define MIRROR_USART2_BRR       (*(volatile uint32_t *)(MIRROR_USART2_BASE + 0x08UL))
+#define MIRROR_USART2_CR1       (*(volatile uint32_t *)(MIRROR_USART2_BASE + 0x0CUL))
+#define MIRROR_USART2_CR3       (*(volatile uint32_t *)(MIRROR_USART2_BASE + 0x14UL))
+#define MIRROR_DMA1_BASE        0x40026000UL
+#define MIRROR_DMA1_HIFCR       (*(volatile uint32_t *)(MIRROR_DMA1_BASE + 0x0CUL))
+#define MIRROR_DMA1_S6CR        (*(volatile uint32_t *)(MIRROR_DMA1_BASE + 0xA0UL))
+#define MIRROR_DMA1_S6NDTR      (*(volatile uint32_t *)(MIRROR_DMA1_BASE + 0xA4UL))
+#define MIRROR_DMA1_S6PAR       (*(volatile uint32_t *)(MIRROR_DMA1_BASE + 0xA8UL))
+#define MIRROR_DMA1_S6M0AR      (*(volatile uint32_t *)(MIRROR_DMA1_BASE + 0xACUL))
+#define MIRROR_NVIC_ISER0       (*(volatile uint32_t *)0xE000E100UL)
+
+#define MIRROR_AHB1ENR_GPIOA    (1U << 0)
+#define MIRROR_AHB1ENR_DMA1     (1U << 21)
+#define MIRROR_APB1ENR_USART2   (1U << 17)
+#define MIRROR_SR_TC            (1U << 6)
+#define MIRROR_CR1_TE           (1U << 3)
+#define MIRROR_CR1_UE           (1U << 13)
+#define MIRROR_CR3_DMAT         (1U << 7)
+#define MIRROR_DMA_CR_EN        (1U << 0)
+#define MIRROR_DMA_CR_TCIE      (1U << 4)
+#define MIRROR_DMA_CR_M2P       (1U << 6)
+#define MIRROR_DMA_CR_MINC      (1U << 10)
+#define MIRROR_DMA_CR_CH4       (4U << 25)  // USART2_TX
+#define MIRROR_DMA_S6_FLAGS     (0x3DUL << 16)
+#define MIRROR_DMA1_S6_IRQ      17U
+#define MIRROR_PCLK1_HZ         16000000UL  // APB1 x1 from the HSI out of reset
+#endif
+
+static bool g_active;
+static mirror_stats_t g_stats;
+
+// Ring: the DMA sends from tail to head; the write being coded grows from
+// head to put and only becomes visible to the DMA once it is complete
+static uint8_t g_ring[MIRROR_RING];
+static volatile uint16_t g_head;
+static volatile uint16_t g_tail;
+static uint16_t g_put;
+static bool g_full;                 // the write being coded ran out of room
+
+#ifdef HOST_BUILD
+static uint64_t g_sent_at;          // simulated cycle the UART caught up to
+#else
+static volatile uint16_t g_dma_len; // bytes in flight, 0 when idle
+#endif
+
+// Current write
+static bool g_open;
+static uint16_t g_win_x, g_win_y, g_win_w, g_win_h;
+static bool g_half;                 // holds the first byte of a pixel
+static uint8_t g_hi;
+static uint16_t g_run_color;
+static uint32_t g_run_len;
+static uint16_t g_lit[MIRROR_MAX_LITERAL];
+static uint32_t g_lit_len;
+
+// Packets still owed to the viewer
+static uint16_t g_screen_w, g_screen_h;
+static bool g_screen_due;
+static uint32_t g_since_screen;
+static bool g_scroll_due;
+static uint16_t g_scroll_head, g_scroll_tail, g_scroll_offset;
+static bool g_lost_due;
+static uint16_t g_lost_x0, g_lost_y0, g_lost_x1, g_lost_y1;
+
+
+#ifdef HOST_BUILD
+// Hands the viewer whatever the UART would have sent by now
+static void drain(bool all)
+{
+    uint64_t now = sim_cycles();
+    uint32_t used = (uint32_t)((g_head - g_tail) & (MIRROR_RING - 1U));
+    uint64_t n = all ? used : (now - g_sent_at) / MIRROR_CYCLES_PER_BYTE;
+    if(n > used) n = used;
+
+    while(n)
+    {
+        uint32_t chunk = (g_head >= g_tail) ? (uint32_t)(g_head - g_tail) : (uint32_t)(MIRROR_RING - g_tail);
+        if(chunk > n) chunk = (uint32_t)n;
+
+        sim_vcp_write(&g_ring[g_tail], chunk);
+        g_tail = (uint16_t)((g_tail + chunk) & (MIRROR_RING - 1U));
+        g_sent_at += chunk * MIRROR_CYCLES_PER_BYTE;
+        g_stats.sent += chunk;
+        n -= chunk;
+    }
+
+    if(all) g_sent_at = now;
+}
+#else
+static void dma_start(void)
+{
+    uint16_t head = g_head;
+    uint16_t tail = g_tail;
+
+    if(head == tail) return;
+
+    // One contiguous piece at a time; the wrap is a second transfer
+    uint16_t len = (uint16_t)((head > tail) ? head - tail : MIRROR_RING - tail);
+
+    g_dma_len = len;
+    MIRROR_DMA1_HIFCR = MIRROR_DMA_S6_FLAGS;
+    MIRROR_DMA1_S6M0AR = (uint32_t)(uintptr_t)&g_ring[tail];
+    MIRROR_DMA1_S6NDTR = len;
+    MIRROR_DMA1_S6CR |= MIRROR_DMA_CR_EN;
+}
+
+void DMA1_Stream6_Handler(void)
+{
+    MIRROR_DMA1_HIFCR = MIRROR_DMA_S6_FLAGS;
+
+    g_stats.sent += g_dma_len;
+    g_tail = (uint16_t)((g_tail + g_dma_len) & (MIRROR_RING - 1U));
+    g_dma_len = 0;
+
+    dma_start();
+}
+#endif
+
+static void kick(void)
+{
+#ifdef HOST_BUILD
+    drain(false);
+#else
+    // Once the DMA is busy, its interrupt picks up the new bytes
+    if(!g_dma_len) dma_start();
+#endif
+}
+
+static void put(uint8_t b)
+{
+    uint16_t next = (uint16_t)((g_put + 1U) & (MIRROR_RING - 1U));
+
+    if(next == g_tail)
+    {
+        g_full = true;
+        return;
+    }
+
+    g_ring[g_put] = b;
+    g_put = next;
+}
+
+static void put_u16(uint16_t v)
+{
+    put((uint8_t)(v >> 8));
+    put((uint8_t)v);
+}
+
+static void put_rect(uint8_t type, uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+    put(MIRROR_SYNC);
+    put(type);
+    put_u16(x);
+    put_u16(y);
+    put_u16(w);
+    put_u16(h);
+}
+
+// Makes everything since the last commit visible to the UART, or throws
+// it away if it did not fit
+static bool commit(void)
+{
+    if(g_full)
+    {
+        g_full = false;
+        g_put = g_head;
+        return false;
+    }
+
+#ifdef HOST_BUILD
+    // An idle line starts sending now, not when it went idle
+    if(g_tail == g_head) g_sent_at = sim_cycles();
+#endif
+
+    g_stats.bytes += (uint32_t)((g_put - g_head) & (MIRROR_RING - 1U));
+    g_head = g_put;
+
+    uint16_t used = (uint16_t)((g_head - g_tail) & (MIRROR_RING - 1U));
+    if(used > g_stats.ring_peak) g_stats.ring_peak = used;
+
+    kick();
+    return true;
+}
+
+static void send_owed(void)
+{
+    if(g_screen_due || g_since_screen >= MIRROR_SCREEN_PERIOD)
+    {
+        put(MIRROR_SYNC);
+        put(MIRROR_PKT_SCREEN);
+        put_u16(g_screen_w);
+        put_u16(g_screen_h);
+        if(!commit()) return;
+
+        g_screen_due = false;
+        g_since_screen = 0;
+
+        // A viewer joining here needs the scroll state too
+        if(g_scroll_head || g_scroll_tail || g_scroll_offset) g_scroll_due = true;
+    }
+
+    if(g_scroll_due)
+    {
+        put(MIRROR_SYNC);
+        put(MIRROR_PKT_SCROLL);
+        put_u16(g_scroll_head);
+        put_u16(g_scroll_tail);
+        put_u16(g_scroll_offset);
+        if(!commit()) return;
+
+        g_scroll_due = false;
+    }
+
+    if(g_lost_due)
+    {
+        put_rect(MIRROR_PKT_LOST, g_lost_x0, g_lost_y0,
+                 (uint16_t)(g_lost_x1 - g_lost_x0), (uint16_t)(g_lost_y1 - g_lost_y0));
+        if(commit()) g_lost_due = false;
+    }
+}
+
+static void add_lost(void)
+{
+    uint16_t x1 = (uint16_t)(g_win_x + g_win_w);
+    uint16_t y1 = (uint16_t)(g_win_y + g_win_h);
+
+    if(!g_lost_due)
+    {
+        g_lost_x0 = g_win_x;
+        g_lost_y0 = g_win_y;
+        g_lost_x1 = x1;
+        g_lost_y1 = y1;
+        g_lost_due = true;
+        return;
+    }
+
+    if(g_win_x < g_lost_x0) g_lost_x0 = g_win_x;
+    if(g_win_y < g_lost_y0) g_lost_y0 = g_win_y;
+    if(x1 > g_lost_x1) g_lost_x1 = x1;
+    if(y1 > g_lost_y1) g_lost_y1 = y1;
+}
+
+// Pixel coder
+
+static void flush_literals(void)
+{
+    if(!g_lit_len) return;
+
+    put((uint8_t)(g_lit_len - 1U));
+    for(uint32_t i = 0; i < g_lit_len; ++i) put_u16(g_lit[i]);
+    g_lit_len = 0;
+}
+
+static void close_run(void)
+{
+    if(g_run_len == 1)
+    {
+        // A lone pixel is cheaper inside a literal block
+        g_lit[g_lit_len++] = g_run_color;
+        if(g_lit_len == MIRROR_MAX_LITERAL) flush_literals();
+    }
+    else if(g_run_len)
+    {
+        uint32_t n = g_run_len;
+
+        flush_literals();
+        if(n <= MIRROR_MAX_RUN)
+        {
+            put((uint8_t)(MIRROR_CODE_RUN | (n - 1U)));
+        }
+        else
+        {
+            put(MIRROR_CODE_LONG_RUN);
+            while(n >= 0x80U)
+            {
+                put((uint8_t)(n | 0x80U));
+                n >>= 7;
+            }
+            put((uint8_t)n);
+        }
+        put_u16(g_run_color);
+    }
+
+    g_run_len = 0;
+}
+
+static inline void code_pixel(uint16_t color)
+{
+    if(g_run_len && color == g_run_color)
+    {
+        ++g_run_len;
+        return;
+    }
+
+    close_run();
+    g_run_color = color;
+    g_run_len = 1;
+}
+
+void mirror_init(void)
+{
+    memset(&g_stats, 0, sizeof(g_stats));
+    g_head = g_tail = g_put = 0;
+    g_full = false;
+    g_open = false;
+    g_screen_due = false;
+    g_since_screen = 0;
+    g_scroll_due = false;
+    g_scroll_head = g_scroll_tail = g_scroll_offset = 0;
+    g_lost_due = false;
+
+#ifdef HOST_BUILD
+    g_sent_at = sim_cycles();
+#else
+    g_dma_len = 0;
+
+    MIRROR_RCC_AHB1ENR |= MIRROR_AHB1ENR_GPIOA | MIRROR_AHB1ENR_DMA1;
+    MIRROR_RCC_APB1ENR |= MIRROR_APB1ENR_USART2;
+    (void)MIRROR_RCC_APB1ENR;
+
+    // PA2 to AF7
+    MIRROR_GPIOA_MODER = (MIRROR_GPIOA_MODER & ~(0x3UL << 4)) | (0x2UL << 4);
+    MIRROR_GPIOA_AFRL = (MIRROR_GPIOA_AFRL & ~(0xFUL << 8)) | (0x7UL << 8);
+
+    MIRROR_USART2_CR1 = 0;
+    MIRROR_USART2_BRR = (uint32_t)((MIRROR_PCLK1_HZ + MIRROR_BAUD / 2U) / MIRROR_BAUD);
+    MIRROR_USART2_CR3 = MIRROR_CR3_DMAT;
+    MIRROR_USART2_CR1 = MIRROR_CR1_UE | MIRROR_CR1_TE;
+
+    MIRROR_DMA1_S6CR = 0;
+    while(MIRROR_DMA1_S6CR & MIRROR_DMA_CR_EN);
+    MIRROR_DMA1_S6PAR = MIRROR_USART2_DR_ADDR;
+    MIRROR_DMA1_S6CR = MIRROR_DMA_CR_CH4 | MIRROR_DMA_CR_MINC | MIRROR_DMA_CR_M2P | MIRROR_DMA_CR_TCIE;
+
+    MIRROR_NVIC_ISER0 = 1UL << MIRROR_DMA1_S6_IRQ;
+#endif
+
+    g_active = true;
+}
+
+void mirror_screen(uint16_t w, uint16_t h)
+{
+    if(!g_active) return;
+
+    g_screen_w = w;
+    g_screen_h = h;
+    g_screen_due = true;
+    send_owed();
+}
+
+void mirror_scroll(uint16_t head, uint16_t tail, uint16_t offset)
+{
+    if(!g_active) return;
+
+    g_scroll_head = head;
+    g_scroll_tail = tail;
+    g_scroll_offset = offset;
+    g_scroll_due = true;
+    send_owed();
+}
+
+void mirror_begin(uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+    if(!g_active) return;
+
+    send_owed();
+
+    g_open = true;
+    g_win_x = x;
+    g_win_y = y;
+    g_win_w = w;
+    g_win_h = h;
+    g_half = false;
+    g_run_len = 0;
+    g_lit_len = 0;
+
+    put_rect(MIRROR_PKT_WINDOW, x, y, w, h);
+}
+
+void mirror_data(const uint8_t *data, uint32_t bytes)
+{
+    if(!g_open) return;
+
+    g_stats.pixels += (bytes + g_half) / 2U;
+    if(g_full) return;
+
+    if(g_half && bytes)
+    {
+        code_pixel((uint16_t)((g_hi << 8) | *data++));
+        --bytes;
+        g_half = false;
+    }
+
+    for(; bytes >= 2; bytes -= 2, data += 2)
+    {
+        code_pixel((uint16_t)((data[0] << 8) | data[1]));
+    }
+
+    if(bytes)
+    {
+        g_hi = *data;
+        g_half = true;
+    }
+}
+
+void mirror_fill(uint16_t color, uint32_t count)
+{
+    if(!g_open || !count) return;
+
+    if(g_half)
+    {
+        // Out of step with the pixel boundary; take the slow way
+        uint8_t px[2] = { (uint8_t)(color >> 8), (uint8_t)color };
+        while(count--) mirror_data(px, 2);
+        return;
+    }
+
+    g_stats.pixels += count;
+    if(g_full) return;
+
+    if(g_run_len && color == g_run_color)
+    {
+        g_run_len += count;
+        return;
+    }
+
+    close_run();
+    g_run_color = color;
+    g_run_len = count;
+}
+
+void mirror_end(void)
+{
+    if(!g_open) return;
+
+    g_open = false;
+    close_run();
+    flush_literals();
+    put(MIRROR_CODE_END);
+
+    if(commit())
+    {
+        g_stats.windows++;
+        g_since_screen++;
+    }
+    else
+    {
+        g_stats.lost++;
+        add_lost();
+    }
+
+    send_owed();
+}
+
+uint32_t mirror_pending(void)
+{
+#ifdef HOST_BUILD
+    if(g_active) drain(false);
+#endif
+    return (uint32_t)((g_head - g_tail) & (MIRROR_RING - 1U));
+}
+
+void mirror_flush(void)
+{
+    if(!g_active) return;
+
+#ifdef HOST_BUILD
+    drain(true);
+#else
+    while(g_head != g_tail);
+    while(!(MIRROR_USART2_SR & MIRROR_SR_TC));
+#endif
+}
+
+const mirror_stats_t *mirror_get_stats(void)
+{
+    return &g_stats;
+}
@@ -0,0 +1,122 @@
+#ifndef DISPLAY_MIRROR_H
+#define DISPLAY_MIRROR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Live copy of everything drawn on the panel, for a viewer on the host.
+//
+// The driver (built with ILI9341_MIRROR) reports each memory write: the
+// window it targets and the pixels it streams. Pixels are run-length
+// coded as they go by and the result is queued in a RAM ring that DMA1
+// stream 6 feeds to USART2 at MIRROR_BAUD, so the CPU only touches each
+// byte once. On the Nucleo board USART2 TX (PA2) is wired to the ST-LINK
+// virtual COM port, so no extra cable is needed.
+//
+// The game already redraws only what changed between frames, so the
+// windows themselves are the frame-to-frame delta; the run-length coding
+// squeezes the solid fills they are made of down to a few bytes each.
+//
+// Nothing here ever waits for the UART. A window that does not fit in the
+// ring is dropped whole and its rectangle is reported as lost, so the
+// viewer knows which part of its copy is stale until it is drawn again.
+//
+// Stream format, all values big-endian:
+//   0x5A 'S' w(u16) h(u16)                  screen size, sent on rotation
+//                                           and every MIRROR_SCREEN_PERIOD
+//                                           windows so a viewer can join late
+//   0x5A 'W' x(u16) y(u16) w(u16) h(u16)    memory write; pixel codes follow
+//   0x5A 'L' x(u16) y(u16) w(u16) h(u16)    rectangle whose writes were dropped
+//   0x5A 'V' head(u16) tail(u16) offset(u16)
+//                                           hardware scroll along the long
+//                                           side (ili9341_set_scroll())
+//
+// Pixel codes, filling the window row by row like the panel does:
+//   0x00-0x7F  n+1 literal pixels follow, RGB565 each
+//   0x80-0xFD  (n & 0x7F)+1 copies of the RGB565 pixel that follows
+//   0xFE       end of the window
+//   0xFF       long run: count as a LEB128 varint, then the RGB565 pixel
+
+#define MIRROR_BAUD             1000000UL
+#define MIRROR_RING             4096    // power of two
+#define MIRROR_SCREEN_PERIOD    256
+
+#define MIRROR_SYNC             0x5A
+#define MIRROR_PKT_SCREEN       'S'
+#define MIRROR_PKT_WINDOW       'W'
+#define MIRROR_PKT_LOST         'L'
+#define MIRROR_PKT_SCROLL       'V'
+
+#define MIRROR_MAX_LITERAL      128
+#define MIRROR_MAX_RUN          126
+#define MIRROR_CODE_RUN         0x80
+#define MIRROR_CODE_END         0xFE
+#define MIRROR_CODE_LONG_RUN    0xFF
+
+typedef struct
+{
+    uint32_t windows;       // windows queued
+    uint32_t lost;          // windows dropped on a full ring
+    uint32_t pixels;        // pixels coded
+    uint32_t bytes;         // bytes queued
+    uint32_t sent;          // bytes handed to the UART
+    uint16_t ring_peak;     // most bytes waiting at once
+} mirror_stats_t;
+
+/**
+ * @brief Sets up USART2 and its pin and starts mirroring.
+ *
+ * Call before ili9341_init() so the viewer gets the screen size.
+ */
+void mirror_init(void);
+
+/**
+ * @brief Announces a new screen size (rotation change).
+ */
+void mirror_screen(uint16_t w, uint16_t h);
+
+/**
+ * @brief Announces a new scroll area or offset.
+ */
+void mirror_scroll(uint16_t head, uint16_t tail, uint16_t offset);
+
+/**
+ * @brief Starts a memory write to a window.
+ */
+void mirror_begin(uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+
+/**
+ * @brief Adds pixel bytes, in wire order, to the current write.
+ *
+ * Bytes may be split anywhere, including between the two halves of a
+ * pixel.
+ */
+void mirror_data(const uint8_t *data, uint32_t bytes);
+
+/**
+ * @brief Adds count copies of one pixel to the current write.
+ */
+void mirror_fill(uint16_t color, uint32_t count);
+
+/**
+ * @brief Ends the current write and queues it, or drops it if the ring
+ *        is too full.
+ */
+void mirror_end(void);
+
+/**
+ * @brief Returns the number of bytes waiting to be sent.
+ */
+uint32_t mirror_pending(void);
+
+/**
+ * @brief Waits until every queued byte has gone out.
+ */
+void mirror_flush(void);
+
+/**
+ * @brief Returns the stream counters.
+ */
+const mirror_stats_t *mirror_get_stats(void);
+
+#endif
@@ -0,0 +1,94 @@
+#include "scroll.h"
+
+#include <string.h>
+
+#include "ili9341.h"
+
+static uint16_t g_head;
+static uint16_t g_lines;        // lines in the scrolling area
+static uint16_t g_offset;
+static uint16_t g_pushed;       // lines of the current push already in
+static uint32_t g_source;       // next marquee line
+static scroll_stats_t g_stats;
+
+
+// Turns the ring by n lines and paints the ones that come round at the
+// far end, taking picture lines from source on
+static void advance(uint16_t n, uint32_t source, scroll_paint_t paint)
+{
+    uint32_t bytes = ili9341_get_tx_bytes();
+    uint16_t first = g_offset;  // ring index of the first line to come round
+
+    g_offset = (uint16_t)((g_offset + n) % g_lines);
+    ili9341_set_scroll(g_offset);
+
+    // The lines are contiguous in the ring but may wrap in drawing space
+    for(uint16_t done = 0; done < n; )
+    {
+        uint16_t index = (uint16_t)((first + done) % g_lines);
+        uint16_t piece = (uint16_t)(n - done);
+        if(piece > g_lines - index) piece = (uint16_t)(g_lines - index);
+
+        paint((uint16_t)(g_head + index), piece, source + done);
+        done = (uint16_t)(done + piece);
+    }
+
+    bytes = ili9341_get_tx_bytes() - bytes;
+    g_stats.frames++;
+    g_stats.lines += n;
+    g_stats.bytes_last = bytes;
+    g_stats.bytes_total += bytes;
+    if(bytes > g_stats.bytes_max) g_stats.bytes_max = bytes;
+}
+
+void scroll_begin(uint16_t head, uint16_t tail)
+{
+    g_head = head;
+    g_lines = (uint16_t)(ILI9341_TFTHEIGHT - head - tail);
+    g_offset = 0;
+    g_pushed = 0;
+    g_source = 0;
+    memset(&g_stats, 0, sizeof(g_stats));
+
+    ili9341_set_scroll_area(head, tail);
+}
+
+bool scroll_push(uint16_t step, scroll_paint_t paint)
+{
+    uint16_t n = (uint16_t)(g_lines - g_pushed);
+    if(step < n) n = step;
+
+    if(n) advance(n, (uint32_t)g_head + g_pushed, paint);
+    g_pushed = (uint16_t)(g_pushed + n);
+
+    if(g_pushed < g_lines) return false;
+
+    g_pushed = 0;
+    return true;
+}
+
+void scroll_marquee(uint16_t step, scroll_paint_t paint)
+{
+    if(step > g_lines) step = g_lines;
+    if(!step) return;
+
+    advance(step, g_source, paint);
+    g_source += step;
+}
+
+void scroll_end(void)
+{
+    g_offset = 0;
+    g_pushed = 0;
+    ili9341_set_scroll_area(0, 0);
+}
+
+uint16_t scroll_offset(void)
+{
+    return g_offset;
+}
+
+const scroll_stats_t *scroll_get_stats(void)
+{
+    return &g_stats;
+}
@@ -0,0 +1,83 @@
+#ifndef DISPLAY_SCROLL_H
+#define DISPLAY_SCROLL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Screen transitions and attract-mode scrolling on the panel's hardware
+// scroll (ili9341_set_scroll_area()).
+//
+// The scrolling area is a ring of lines in panel RAM. Each frame moves the
+// scroll start by a few lines, which costs one 3-byte command, and only
+// the lines that have just wrapped round to the far end are repainted, so
+// the picture already on the panel never goes over SPI again.
+//
+// Lines run along the scroll axis: columns in the landscape rotations,
+// rows in the portrait ones. Paint callbacks are given drawing
+// coordinates and draw whole lines across the screen.
+//
+// A push starts wherever the scroll offset is and ends, after one full
+// turn of the ring, back at the same offset with the new picture in
+// place. Started at offset 0 it leaves drawing and screen coordinates the
+// same again.
+
+/**
+ * @brief Draws count whole lines from line `source` of some picture into
+ *        drawing lines line .. line + count - 1.
+ *
+ * For a push, `source` is the screen position the lines will end up at.
+ * For a marquee it counts up forever.
+ */
+typedef void (*scroll_paint_t)(uint16_t line, uint16_t count, uint32_t source);
+
+typedef struct
+{
+    uint32_t frames;
+    uint32_t lines;         // lines painted
+    uint32_t bytes_last;    // bus bytes, last frame
+    uint32_t bytes_max;
+    uint32_t bytes_total;
+} scroll_stats_t;
+
+/**
+ * @brief Sets the scrolling area and resets the offset to 0.
+ *
+ * @param head Fixed lines at the start of the axis.
+ * @param tail Fixed lines at the end of the axis.
+ */
+void scroll_begin(uint16_t head, uint16_t tail);
+
+/**
+ * @brief Runs one frame of a push: the picture slides towards the start
+ *        of the axis by `step` lines and the same number of lines of the
+ *        new picture come in at the far end.
+ *
+ * @return true once the new picture fills the scrolling area.
+ */
+bool scroll_push(uint16_t step, scroll_paint_t paint);
+
+/**
+ * @brief Runs one frame of an endless scroll, painting the lines that
+ *        come in from a picture that never ends.
+ */
+void scroll_marquee(uint16_t step, scroll_paint_t paint);
+
+/**
+ * @brief Returns to a full-screen scrolling area at offset 0.
+ *
+ * The picture only stays put if the offset is already 0, as it is after
+ * a push started at 0.
+ */
+void scroll_end(void);
+
+/**
+ * @brief Returns the scroll offset.
+ */
+uint16_t scroll_offset(void);
+
+/**
+ * @brief Returns the frame and bus counters since scroll_begin().
+ */
+const scroll_stats_t *scroll_get_stats(void);
+
+#endif
@@ -0,0 +1,319 @@
+#include "spiq.h"
+
+#include <string.h>
+
+#include "ili9341.h"
+#include "perf.h"
+
+#ifdef HOST_BUILD
+#include "sim.h"
+
+#define SPIQ_IRQ_OVERHEAD   0U      // SIM_CYCLES_PER_SPI_IRQ covers it all
+#else
+// Registers of the panel's SPI peripheral and control port, as set up in
+// ili9341.h
+#define SPIQ_SPI_BASE       ((uintptr_t)ILI9341_SPI_PERIPHERAL)
+#define SPIQ_SPI_CR2        (*(volatile uint32_t *)(SPIQ_SPI_BASE + 0x04UL))
+#define SPIQ_SPI_SR         (*(volatile uint32_t *)(SPIQ_SPI_BASE + 0x08UL))
+#define SPIQ_SPI_DR         (*(volatile uint8_t *)(SPIQ_SPI_BASE + 0x0CUL))
+#define SPIQ_PORT_BSRR      (*(volatile uint32_t *)((uintptr_t)ILI9341_CONTROL_PORT + 0x18UL))
+#define SPIQ_NVIC_ISER      (*(volatile uint32_t *)(0xE000E100UL + 4UL * (ILI9341_SPI_IRQ / 32U)))
+#define SPIQ_NVIC_ICER      (*(volatile uint32_t *)(0xE000E180UL + 4UL * (ILI9341_SPI_IRQ / 32U)))
+
+#define SPIQ_CR2_RXNEIE     (1U << 6)
+#define SPIQ_CR2_TXEIE      (1U << 7)
+#define SPIQ_SR_TXE         (1U << 1)
+#define SPIQ_SR_BSY         (1U << 7)
+#define SPIQ_IRQ_OVERHEAD   24U     // exception entry and exit, outside the DWT reads
+#endif
+
+typedef enum
+{
+    SPIQ_OP_BYTE,           // value is the byte
+    SPIQ_OP_BLOCK,          // data/len, sent in place
+    SPIQ_OP_CS,             // value is the level
+    SPIQ_OP_DC
+} spiq_op_t;
+
+// Which SPI interrupt the queue has enabled
+typedef enum
+{
+    SPIQ_IRQ_NONE,          // ring ran dry; the next kick() enables TXE
+    SPIQ_IRQ_TXE,           // room for the next byte
+    SPIQ_IRQ_RXNE           // a marker waits for the byte in the shifter
+} spiq_irq_t;
+
+typedef struct
+{
+    const uint8_t *data;    // SPIQ_OP_BLOCK: next byte to send
+    uint16_t len;           // SPIQ_OP_BLOCK: bytes left
+    uint8_t op;
+    uint8_t value;
+} spiq_entry_t;
+
+// The interrupt takes entries from tail to head and owns the one at the
+// tail until it moves past it
+static spiq_entry_t g_ring[SPIQ_RING];
+static volatile uint16_t g_head;
+static volatile uint16_t g_tail;
+static volatile uint8_t g_irq;
+static bool g_active;
+static spiq_stats_t g_stats;
+
+
+static inline uint16_t next(uint16_t i)
+{
+    return (uint16_t)((i + 1U) & (SPIQ_RING - 1U));
+}
+
+static inline void bus_write(uint8_t b)
+{
+#ifdef HOST_BUILD
+    sim_spi_async(&b, 1);
+#else
+    SPIQ_SPI_DR = b;
+#endif
+}
+
+// Only called with TXE set, so at most one byte is left in the shifter
+static inline bool bus_busy(void)
+{
+#ifdef HOST_BUILD
+    return sim_cycles() < sim_spi_idle_at();
+#else
+    // Reading DR empties the receive side, so RXNE next rises when the
+    // byte still shifting, if any, is out. A byte that was already out
+    // has dropped BSY by the time SR is read.
+    (void)SPIQ_SPI_DR;
+    return (SPIQ_SPI_SR & SPIQ_SR_BSY) != 0U;
+#endif
+}
+
+static inline void bus_pin(uint8_t pin, uint8_t level)
+{
+#ifdef HOST_BUILD
+    sim_pin_async(pin, level);
+#else
+    SPIQ_PORT_BSRR = level ? (1UL << pin) : (1UL << (pin + 16U));
+#endif
+}
+
+// Applies the markers at the front of the ring, then puts the next byte
+// in the data register. Returns the interrupt to wait for next.
+static spiq_irq_t service(bool shifter_idle)
+{
+    while(g_tail != g_head)
+    {
+        spiq_entry_t *e = &g_ring[g_tail];
+
+        if(e->op == SPIQ_OP_BYTE)
+        {
+            g_tail = next(g_tail);
+            bus_write(e->value);
+            return SPIQ_IRQ_TXE;
+        }
+        if(e->op == SPIQ_OP_BLOCK)
+        {
+            uint8_t b = *e->data++;
+            if(!--e->len) g_tail = next(g_tail);
+            bus_write(b);
+            return SPIQ_IRQ_TXE;
+        }
+
+        // The byte in the shifter must finish under the old levels
+        if(!shifter_idle && bus_busy()) return SPIQ_IRQ_RXNE;
+        shifter_idle = true;
+
+        bus_pin(e->op == SPIQ_OP_CS ? ILI9341_CS_PIN : ILI9341_DC_PIN, e->value);
+        g_tail = next(g_tail);
+    }
+    return SPIQ_IRQ_NONE;
+}
+
+// One interrupt, counted. RXNE only comes once the shifter is empty.
+static void spi_interrupt(void)
+{
+    uint32_t start = perf_cycles();
+    bool rxne = (g_irq == SPIQ_IRQ_RXNE);
+
+#ifdef HOST_BUILD
+    sim_advance(SIM_CYCLES_PER_SPI_IRQ);
+#endif
+
+    spiq_irq_t irq = service(rxne);
+    g_irq = (uint8_t)irq;
+
+#ifndef HOST_BUILD
+    uint32_t cr2 = SPIQ_SPI_CR2 & ~(SPIQ_CR2_TXEIE | SPIQ_CR2_RXNEIE);
+    if(irq == SPIQ_IRQ_TXE) cr2 |= SPIQ_CR2_TXEIE;
+    if(irq == SPIQ_IRQ_RXNE) cr2 |= SPIQ_CR2_RXNEIE;
+    SPIQ_SPI_CR2 = cr2;
+#endif
+
+    g_stats.irqs++;
+    if(rxne) g_stats.idle_irqs++;
+    g_stats.isr_cycles += perf_cycles() - start + SPIQ_IRQ_OVERHEAD;
+}
+
+#ifndef HOST_BUILD
+void ILI9341_SPI_HANDLER(void)
+{
+    spi_interrupt();
+}
+#endif
+
+#ifdef HOST_BUILD
+// The modelled interrupt runs the ring dry straight away, while the bus
+// model keeps each byte on the wire for its real time. Once those bytes
+// are out the interrupt has fired one last time on an empty ring and
+// switched itself off, so a later kick starts a fresh run as it would on
+// the target.
+static void settle(void)
+{
+    if(g_irq != SPIQ_IRQ_NONE && g_tail == g_head && sim_cycles() >= sim_spi_idle_at()) spi_interrupt();
+}
+#endif
+
+// Starts the interrupt if the ring had run dry. While it runs, it finds
+// new entries by itself.
+static void kick(void)
+{
+#ifdef HOST_BUILD
+    if(g_irq == SPIQ_IRQ_NONE) g_irq = SPIQ_IRQ_TXE;
+    while(g_irq != SPIQ_IRQ_NONE && g_tail != g_head) spi_interrupt();
+#else
+    if(g_irq != SPIQ_IRQ_NONE) return;
+
+    g_irq = SPIQ_IRQ_TXE;
+    SPIQ_SPI_CR2 |= SPIQ_CR2_TXEIE;
+#endif
+}
+
+static void put(uint8_t op, uint8_t value, const uint8_t *data, uint16_t len)
+{
+    uint16_t head = g_head;
+    uint16_t n = next(head);
+
+#ifdef HOST_BUILD
+    sim_advance(SIM_CYCLES_PER_SPI_PUT);
+    settle();
+#endif
+
+    if(n == g_tail)
+    {
+        uint32_t start = perf_cycles();
+        g_stats.full_waits++;
+
+        kick();
+        while(n == g_tail);
+
+        g_stats.wait_cycles += perf_cycles() - start;
+    }
+
+    spiq_entry_t *e = &g_ring[head];
+    e->op = op;
+    e->value = value;
+    e->data = data;
+    e->len = len;
+
+    // The entry must be complete before the interrupt can see it
+    __asm volatile ("" ::: "memory");
+    g_head = n;
+
+    uint16_t used = (uint16_t)((n - g_tail) & (SPIQ_RING - 1U));
+    if(used > g_stats.ring_peak) g_stats.ring_peak = used;
+}
+
+void spiq_init(void)
+{
+    memset(&g_stats, 0, sizeof(g_stats));
+    g_head = g_tail = 0;
+    g_irq = SPIQ_IRQ_NONE;
+
+#ifndef HOST_BUILD
+    SPIQ_SPI_CR2 &= ~(SPIQ_CR2_TXEIE | SPIQ_CR2_RXNEIE);
+    SPIQ_NVIC_ISER = 1UL << (ILI9341_SPI_IRQ % 32U);
+#endif
+
+    g_active = true;
+}
+
+void spiq_stop(void)
+{
+    spiq_fence();
+    g_active = false;
+
+#ifndef HOST_BUILD
+    SPIQ_NVIC_ICER = 1UL << (ILI9341_SPI_IRQ % 32U);
+#endif
+}
+
+bool spiq_active(void)
+{
+    return g_active;
+}
+
+void spiq_cs(bool high)
+{
+    put(SPIQ_OP_CS, high ? 1U : 0U, NULL, 0);
+    g_stats.markers++;
+    kick();
+}
+
+void spiq_dc(bool high)
+{
+    put(SPIQ_OP_DC, high ? 1U : 0U, NULL, 0);
+    g_stats.markers++;
+    kick();
+}
+
+void spiq_bytes(const uint8_t *data, uint32_t len)
+{
+    g_stats.bytes += len;
+    while(len--) put(SPIQ_OP_BYTE, *data++, NULL, 0);
+    kick();
+}
+
+void spiq_block(const uint8_t *data, uint32_t len)
+{
+    g_stats.bytes += len;
+    while(len)
+    {
+        uint16_t chunk = (len > 0xFFFFU) ? 0xFFFFU : (uint16_t)len;
+        put(SPIQ_OP_BLOCK, 0, data, chunk);
+        data += chunk;
+        len -= chunk;
+    }
+    kick();
+}
+
+void spiq_fence(void)
+{
+    if(!g_active) return;
+
+#ifdef HOST_BUILD
+    if(g_irq != SPIQ_IRQ_NONE) spi_interrupt();     // the last one, on an empty ring
+
+    uint64_t idle = sim_spi_idle_at();
+    if(sim_cycles() >= idle) return;
+
+    g_stats.fences++;
+    g_stats.wait_cycles += idle - sim_cycles();
+    sim_advance(idle - sim_cycles());
+#else
+    if(g_tail == g_head && (SPIQ_SPI_SR & SPIQ_SR_TXE) && !(SPIQ_SPI_SR & SPIQ_SR_BSY)) return;
+
+    uint32_t start = perf_cycles();
+    g_stats.fences++;
+
+    while(g_tail != g_head);
+    while(!(SPIQ_SPI_SR & SPIQ_SR_TXE) || (SPIQ_SPI_SR & SPIQ_SR_BSY));
+
+    g_stats.wait_cycles += perf_cycles() - start;
+#endif
+}
+
+const spiq_stats_t *spiq_get_stats(void)
+{
+    return &g_stats;
+}
@@ -0,0 +1,104 @@
+#ifndef DISPLAY_SPIQ_H
+#define DISPLAY_SPIQ_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Interrupt-driven transmit queue for the panel's short SPI transfers.
+//
+// Commands, their parameters and sprite packets are a few bytes each, so
+// DMA setup costs more than it saves on them, and sent from the CPU each
+// one ends in a spin on the BSY flag before the next CS or DC change.
+// With the queue running (the driver built with ILI9341_SPI_QUEUE, then
+// spiq_init()), the driver puts them in a RAM ring instead and returns;
+// the SPI interrupt feeds the ring to the data register one byte per TXE.
+//
+// CS and DC changes travel through the ring as markers between the
+// bytes. A marker may only be applied once the byte before it has left
+// the shifter. If it has not, the interrupt switches from TXE to RXNE
+// and returns; RXNE rises when that byte is out, and the marker goes out
+// on that interrupt. The interrupt never waits on the bus itself, and a
+// whole select / command / parameters / release sequence can be queued
+// in one go.
+//
+// Anything that drives the bus or the control lines directly, like the
+// driver's pixel streams, must call spiq_fence() first. It waits until
+// the ring is empty and the last byte has left the shifter.
+//
+// Each byte costs one interrupt, some 40 cycles with entry and exit,
+// against 16 cycles of wire time at the default SPI2 clock, so the queue
+// only hands time back when the bus runs slower than that. It is off
+// unless built in; host/spiqbench measures both ways.
+
+#define SPIQ_RING   128     // entries, power of two
+
+typedef struct
+{
+    uint32_t bytes;         // bytes queued
+    uint32_t markers;       // CS and DC changes queued
+    uint32_t irqs;          // interrupts taken, TXE and RXNE
+    uint32_t idle_irqs;     // RXNE ones, for a marker behind a shifting byte
+    uint64_t isr_cycles;    // cycles spent in them, entry and exit included
+    uint32_t fences;        // spiq_fence() calls that had to wait
+    uint32_t full_waits;    // waits for room in a full ring
+    uint64_t wait_cycles;   // cycles spent in both kinds of wait, interrupts included
+    uint16_t ring_peak;     // most entries waiting at once
+} spiq_stats_t;
+
+/**
+ * @brief Enables the SPI interrupt and starts queueing.
+ *
+ * Call after the SPI peripheral itself is set up (pong_init()).
+ */
+void spiq_init(void);
+
+/**
+ * @brief Drains the queue and goes back to sending from the CPU.
+ */
+void spiq_stop(void);
+
+/**
+ * @brief Returns true while the queue is running.
+ */
+bool spiq_active(void);
+
+/**
+ * @brief Queues a change of the chip select line.
+ *
+ * @param high true to release the panel, false to select it.
+ */
+void spiq_cs(bool high);
+
+/**
+ * @brief Queues a change of the data/command line.
+ *
+ * @param high true for data, false for a command.
+ */
+void spiq_dc(bool high);
+
+/**
+ * @brief Queues bytes by copying them into the ring.
+ */
+void spiq_bytes(const uint8_t *data, uint32_t len);
+
+/**
+ * @brief Queues bytes by reference, for large blocks that do not change.
+ *
+ * The bytes are read as they go out: they must stay as they are until
+ * the next spiq_fence().
+ */
+void spiq_block(const uint8_t *data, uint32_t len);
+
+/**
+ * @brief Waits until everything queued has gone out and the bus is idle.
+ *
+ * Returns at once when the queue is not running.
+ */
+void spiq_fence(void);
+
+/**
+ * @brief Returns the queue counters since spiq_init().
+ */
+const spiq_stats_t *spiq_get_stats(void);
+
+#endif
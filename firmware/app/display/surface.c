@@ -0,0 +1,214 @@
+#include "surface.h"
+
+#include <string.h>
+
+#include "arena.h"
+#include "ili9341.h"
+
+
+static inline uint8_t get_index(const surface_t *surface, uint16_t x, uint16_t y)
+{
+    uint8_t b = surface->pixels[(uint32_t)y * surface->stride + x / 2U];
+    return (x & 1U) ? (uint8_t)(b & 0x0F) : (uint8_t)(b >> 4);
+}
+
+static inline void put_index(surface_t *surface, uint16_t x, uint16_t y, uint8_t index)
+{
+    uint8_t *b = &surface->pixels[(uint32_t)y * surface->stride + x / 2U];
+    if(x & 1U) *b = (uint8_t)((*b & 0xF0) | index);
+    else       *b = (uint8_t)((*b & 0x0F) | (index << 4));
+}
+
+static inline void put_color(uint8_t *out, uint16_t color)
+{
+    out[0] = (uint8_t)(color >> 8);
+    out[1] = (uint8_t)color;
+}
+
+// Clips [x, x + w) to [0, limit); false if nothing is left
+static bool clip(int16_t *x, int16_t *w, uint16_t limit)
+{
+    int32_t x0 = *x;
+    int32_t x1 = (int32_t)*x + *w;
+
+    if(x0 < 0) x0 = 0;
+    if(x1 > limit) x1 = limit;
+    if(x1 <= x0) return false;
+
+    *x = (int16_t)x0;
+    *w = (int16_t)(x1 - x0);
+    return true;
+}
+
+static void fill_row(surface_t *surface, uint16_t x, uint16_t y, uint16_t w, uint8_t index)
+{
+    uint8_t *row = &surface->pixels[(uint32_t)y * surface->stride];
+
+    // Odd leading pixel, whole bytes, odd trailing pixel
+    if(x & 1U)
+    {
+        put_index(surface, x, y, index);
+        ++x;
+        --w;
+    }
+
+    memset(&row[x / 2U], (index << 4) | index, w / 2U);
+
+    if(w & 1U)
+    {
+        put_index(surface, (uint16_t)(x + w - 1U), y, index);
+    }
+}
+
+void surface_set_palette(surface_palette_t *palette, const uint16_t *colors)
+{
+    memcpy(palette->colors, colors, sizeof(palette->colors));
+
+    for(uint32_t b = 0; b < 256U; ++b)
+    {
+        uint8_t wire[4];
+        put_color(&wire[0], colors[b >> 4]);
+        put_color(&wire[2], colors[b & 0x0F]);
+        memcpy(&palette->pairs[b], wire, sizeof(wire));
+    }
+}
+
+void surface_init(surface_t *surface, uint8_t *pixels, uint16_t w, uint16_t h,
+                  const surface_palette_t *palette)
+{
+    surface->w = w;
+    surface->h = h;
+    surface->stride = (uint16_t)((w + 1U) / 2U);
+    surface->pixels = pixels;
+    surface->palette = palette;
+}
+
+void surface_clear(surface_t *surface, uint8_t index)
+{
+    memset(surface->pixels, (index << 4) | index, SURFACE_BYTES(surface->w, surface->h));
+}
+
+void surface_fill_rect(surface_t *surface, int16_t x, int16_t y, int16_t w, int16_t h,
+                       uint8_t index)
+{
+    if(!clip(&x, &w, surface->w) || !clip(&y, &h, surface->h)) return;
+
+    for(int16_t row = y; row < y + h; ++row)
+    {
+        fill_row(surface, (uint16_t)x, (uint16_t)row, (uint16_t)w, index);
+    }
+}
+
+void surface_draw_span(surface_t *surface, int16_t x, int16_t y, int16_t w, uint8_t index)
+{
+    if(y < 0 || y >= surface->h || !clip(&x, &w, surface->w)) return;
+
+    fill_row(surface, (uint16_t)x, (uint16_t)y, (uint16_t)w, index);
+}
+
+void surface_draw_glyph(surface_t *surface, int16_t x, int16_t y, const uint8_t *bits,
+                        uint8_t w, uint8_t h, uint8_t index)
+{
+    const uint16_t pitch = (uint16_t)((w + 7U) / 8U);
+
+    for(uint16_t gy = 0; gy < h; ++gy)
+    {
+        int32_t py = y + gy;
+        if(py < 0 || py >= surface->h) continue;
+
+        const uint8_t *row = &bits[gy * pitch];
+        for(uint16_t gx = 0; gx < w; ++gx)
+        {
+            int32_t px = x + gx;
+            if(px < 0 || px >= surface->w) continue;
+
+            if(row[gx / 8U] & (0x80U >> (gx & 7U)))
+            {
+                put_index(surface, (uint16_t)px, (uint16_t)py, index);
+            }
+        }
+    }
+}
+
+void surface_expand(const surface_t *surface, uint16_t x, uint16_t y, uint16_t count,
+                    uint8_t *out)
+{
+    const surface_palette_t *palette = surface->palette;
+
+    if(count == 0) return;
+
+    // A run starting on an odd pixel takes its first one from a low nibble
+    if(x & 1U)
+    {
+        put_color(out, palette->colors[get_index(surface, x, y)]);
+        out += 2;
+        ++x;
+        --count;
+    }
+
+    const uint8_t *src = &surface->pixels[(uint32_t)y * surface->stride + x / 2U];
+    for(uint16_t n = count / 2U; n; --n)
+    {
+        memcpy(out, &palette->pairs[*src++], 4);
+        out += 4;
+    }
+
+    if(count & 1U)
+    {
+        put_color(out, palette->colors[*src >> 4]);
+    }
+}
+
+void surface_flush(const surface_t *surface, uint16_t sx, uint16_t sy, uint16_t w, uint16_t h,
+                   uint16_t dx, uint16_t dy)
+{
+    uint16_t used = 0;
+
+    if(sx >= surface->w || sy >= surface->h) return;
+    if(w > surface->w - sx) w = (uint16_t)(surface->w - sx);
+    if(h > surface->h - sy) h = (uint16_t)(surface->h - sy);
+    if(w == 0 || h == 0) return;
+
+    // The chunk comes from the arena; without room, a few pixels on the
+    // stack still get the region out, in more transfers
+    uint8_t fallback[SURFACE_FALLBACK_PIXELS * 2U];
+    const arena_mark_t mark = arena_mark();
+    uint8_t *chunk = arena_alloc(SURFACE_CHUNK_PIXELS * 2U);
+    uint16_t chunk_pixels = SURFACE_CHUNK_PIXELS;
+    if(!chunk)
+    {
+        chunk = fallback;
+        chunk_pixels = SURFACE_FALLBACK_PIXELS;
+    }
+
+    ili9341_begin_write(dx, dy, w, h);
+
+    // Rows follow each other in the window, so a chunk can span rows
+    for(uint16_t y = sy; y < sy + h; ++y)
+    {
+        uint16_t x = sx;
+        uint16_t left = w;
+
+        while(left)
+        {
+            uint16_t take = (uint16_t)(chunk_pixels - used);
+            if(take > left) take = left;
+
+            surface_expand(surface, x, y, take, &chunk[used * 2U]);
+            used = (uint16_t)(used + take);
+            x = (uint16_t)(x + take);
+            left = (uint16_t)(left - take);
+
+            if(used == chunk_pixels)
+            {
+                ili9341_write_data(chunk, used * 2U);
+                used = 0;
+            }
+        }
+    }
+
+    if(used) ili9341_write_data(chunk, used * 2U);
+
+    ili9341_end_write();
+    arena_release(mark);
+}
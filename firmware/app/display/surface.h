@@ -0,0 +1,132 @@
+#ifndef DISPLAY_SURFACE_H
+#define DISPLAY_SURFACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Palette-indexed offscreen surfaces.
+//
+// Pixels are 4-bit indices into a 16-color palette, two per byte with the
+// left pixel in the high nibble, so a surface costs a quarter of the same
+// area in RGB565. Drawing only touches the indices.
+//
+// Flushing expands indices to RGB565 just ahead of the SPI transmit, one
+// small chunk at a time. The palette keeps a 256-entry table that maps a
+// whole index byte to its two pixels in wire order, so the inner loop is
+// one load and one store per two pixels. The chunk is arena.h scratch,
+// held only while surface_flush() runs.
+
+#define SURFACE_PALETTE_SIZE  16
+#define SURFACE_CHUNK_PIXELS  128   // expansion buffer, 2 bytes per pixel
+#define SURFACE_FALLBACK_PIXELS 8   // on the stack when the arena is full
+
+// Bytes needed for a w x h surface
+#define SURFACE_BYTES(w, h)   ((uint32_t)(((w) + 1U) / 2U) * (uint32_t)(h))
+
+typedef struct
+{
+    uint16_t colors[SURFACE_PALETTE_SIZE];  // RGB565
+    uint32_t pairs[256];                    // index byte -> two pixels, wire order
+} surface_palette_t;
+
+typedef struct
+{
+    uint16_t w;
+    uint16_t h;
+    uint16_t stride;                        // bytes per row
+    uint8_t *pixels;                        // SURFACE_BYTES(w, h) bytes
+    const surface_palette_t *palette;
+} surface_t;
+
+/**
+ * @brief Sets the palette colors and rebuilds the expansion table.
+ *
+ * @param palette Palette to fill.
+ * @param colors  SURFACE_PALETTE_SIZE RGB565 colors.
+ */
+void surface_set_palette(surface_palette_t *palette, const uint16_t *colors);
+
+/**
+ * @brief Binds a surface to its pixel memory and palette.
+ *
+ * @param surface Surface to set up.
+ * @param pixels  SURFACE_BYTES(w, h) bytes of storage.
+ * @param w       Width in pixels.
+ * @param h       Height in pixels.
+ * @param palette Palette used when flushing.
+ */
+void surface_init(surface_t *surface, uint8_t *pixels, uint16_t w, uint16_t h,
+                  const surface_palette_t *palette);
+
+/**
+ * @brief Sets every pixel to one index.
+ */
+void surface_clear(surface_t *surface, uint8_t index);
+
+/**
+ * @brief Fills a rectangle, clipped to the surface.
+ *
+ * @param surface Surface to draw into.
+ * @param x       X-coordinate of the top-left corner, may be negative.
+ * @param y       Y-coordinate of the top-left corner, may be negative.
+ * @param w       Width in pixels.
+ * @param h       Height in pixels.
+ * @param index   Palette index.
+ */
+void surface_fill_rect(surface_t *surface, int16_t x, int16_t y, int16_t w, int16_t h,
+                       uint8_t index);
+
+/**
+ * @brief Fills a horizontal span, clipped to the surface.
+ *
+ * @param surface Surface to draw into.
+ * @param x       Starting X-coordinate, may be negative.
+ * @param y       Y-coordinate.
+ * @param w       Length in pixels.
+ * @param index   Palette index.
+ */
+void surface_draw_span(surface_t *surface, int16_t x, int16_t y, int16_t w, uint8_t index);
+
+/**
+ * @brief Draws the set bits of a 1-bit glyph, clipped to the surface.
+ *
+ * Clear bits are left untouched.
+ *
+ * @param surface Surface to draw into.
+ * @param x       X-coordinate of the top-left corner, may be negative.
+ * @param y       Y-coordinate of the top-left corner, may be negative.
+ * @param bits    Glyph rows, (w + 7) / 8 bytes each, leftmost pixel in the MSB.
+ * @param w       Glyph width in pixels.
+ * @param h       Glyph height in pixels.
+ * @param index   Palette index for set bits.
+ */
+void surface_draw_glyph(surface_t *surface, int16_t x, int16_t y, const uint8_t *bits,
+                        uint8_t w, uint8_t h, uint8_t index);
+
+/**
+ * @brief Expands a run of pixels from one row to RGB565 wire bytes.
+ *
+ * @param surface Surface to read.
+ * @param x       First pixel.
+ * @param y       Row.
+ * @param count   Number of pixels; x + count must not pass the row end.
+ * @param out     Receives 2 * count bytes.
+ */
+void surface_expand(const surface_t *surface, uint16_t x, uint16_t y, uint16_t count,
+                    uint8_t *out);
+
+/**
+ * @brief Sends a region of the surface to the display in one window.
+ *
+ * @param surface Surface to send.
+ * @param sx      Region left edge in the surface.
+ * @param sy      Region top edge in the surface.
+ * @param w       Region width; clipped to the surface.
+ * @param h       Region height; clipped to the surface.
+ * @param dx      Screen X-coordinate of the region.
+ * @param dy      Screen Y-coordinate of the region.
+ */
+void surface_flush(const surface_t *surface, uint16_t sx, uint16_t sy, uint16_t w, uint16_t h,
+                   uint16_t dx, uint16_t dy);
+
+#endif
@@ -0,0 +1,108 @@
+#include "governor.h"
+
+#include <string.h>
+
+typedef struct
+{
+    uint32_t tick_cycles;
+    uint8_t target_divider;
+    uint8_t phase;          // ticks since the last frame
+    uint8_t calm;           // consecutive frames under the low mark
+} governor_t;
+
+static governor_t g_gov;
+static governor_stats_t g_stats;
+
+
+void governor_init(uint32_t tick_cycles, uint8_t target_divider)
+{
+    if(target_divider == 0) target_divider = 1;
+    if(target_divider > GOVERNOR_MAX_DIVIDER) target_divider = GOVERNOR_MAX_DIVIDER;
+
+    memset(&g_gov, 0, sizeof(g_gov));
+    memset(&g_stats, 0, sizeof(g_stats));
+
+    g_gov.tick_cycles = tick_cycles;
+    g_gov.target_divider = target_divider;
+    g_stats.divider = target_divider;
+}
+
+bool governor_tick(void)
+{
+    g_stats.ticks++;
+
+    if(++g_gov.phase < g_stats.divider) return false;
+
+    g_gov.phase = 0;
+    return true;
+}
+
+bool governor_shed(void)
+{
+    return g_stats.shed;
+}
+
+void governor_frame_done(uint32_t render_cycles)
+{
+    uint32_t budget = g_gov.tick_cycles * g_stats.divider;
+    uint32_t high = (uint32_t)(((uint64_t)budget * GOVERNOR_HIGH_PERMILLE) / 1000U);
+    uint32_t low = (uint32_t)(((uint64_t)budget * GOVERNOR_LOW_PERMILLE) / 1000U);
+
+    g_stats.render_cycles = render_cycles;
+    g_stats.budget_cycles = budget;
+    if(render_cycles > g_stats.render_max) g_stats.render_max = render_cycles;
+
+    if(g_stats.frames == 0) g_stats.render_avg = render_cycles;
+    else g_stats.render_avg = g_stats.render_avg - g_stats.render_avg / 8U + render_cycles / 8U;
+
+    g_stats.frames++;
+    if(g_stats.shed) g_stats.shed_frames++;
+    if(render_cycles > budget && g_stats.divider == GOVERNOR_MAX_DIVIDER) g_stats.saturated++;
+
+    if(render_cycles > high)
+    {
+        // React to a single heavy frame straight away
+        g_stats.over_budget++;
+        g_gov.calm = 0;
+
+        if(!g_stats.shed)
+        {
+            g_stats.shed = true;
+        }
+        else if(g_stats.divider < GOVERNOR_MAX_DIVIDER)
+        {
+            g_stats.divider++;
+            g_stats.rate_drops++;
+        }
+        return;
+    }
+
+    // Only back off once the average has been low for a while
+    if(g_stats.render_avg >= low)
+    {
+        g_gov.calm = 0;
+        return;
+    }
+    if(++g_gov.calm < GOVERNOR_CALM_FRAMES) return;
+    g_gov.calm = 0;
+
+    if(g_stats.shed)
+    {
+        g_stats.shed = false;
+    }
+    else if(g_stats.divider > g_gov.target_divider)
+    {
+        // Only raise if the frame would still fit at the faster rate
+        uint32_t faster = g_gov.tick_cycles * (uint32_t)(g_stats.divider - 1U);
+        if(g_stats.render_avg < (uint32_t)(((uint64_t)faster * GOVERNOR_LOW_PERMILLE) / 1000U))
+        {
+            g_stats.divider--;
+            g_stats.rate_raises++;
+        }
+    }
+}
+
+const governor_stats_t *governor_get_stats(void)
+{
+    return &g_stats;
+}
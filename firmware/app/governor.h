@@ -0,0 +1,87 @@
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Adaptive frame pacing.
+//
+// The game steps at a fixed tick rate so its speed never changes. The
+// governor decides how often a tick is also drawn: every tick at the
+// target rate, or every 2nd, 3rd... tick when drawing does not fit. Each
+// drawn frame's render time is measured against its budget (the ticks
+// it covers):
+//   - over budget: first shed optional work (deferred repairs), then
+//     drop the frame rate one step
+//   - well under budget for a while: bring back optional work, then
+//     raise the frame rate back towards the target
+//
+// The policy only sees the render times passed to governor_frame_done(),
+// so it can be driven by a simulated bus on the host.
+//
+// The range is limited: a frame that takes longer than GOVERNOR_MAX_DIVIDER
+// ticks cannot be paced any further, and the game falls behind its tick
+// rate. Such frames are counted in `saturated`.
+
+#define GOVERNOR_MAX_DIVIDER   4    // lowest frame rate: target / 4
+#define GOVERNOR_HIGH_PERMILLE 900  // over budget above 90 %
+#define GOVERNOR_LOW_PERMILLE  500  // under budget below 50 % ...
+#define GOVERNOR_CALM_FRAMES   30   // ... for this many frames in a row
+
+typedef struct
+{
+    // Last drawn frame
+    uint32_t render_cycles;
+    uint32_t budget_cycles;
+
+    // Smoothed render time (1/8 weight for new frames)
+    uint32_t render_avg;
+    uint32_t render_max;
+
+    // Current decisions
+    uint8_t divider;        // draw every n-th tick
+    bool shed;              // optional work deferred
+
+    // Since governor_init()
+    uint32_t ticks;
+    uint32_t frames;
+    uint32_t shed_frames;
+    uint32_t over_budget;
+    uint32_t rate_drops;
+    uint32_t rate_raises;
+    uint32_t saturated;     // over budget at the lowest rate: ticks fall behind
+} governor_stats_t;
+
+/**
+ * @brief Resets the governor.
+ *
+ * @param tick_cycles    Length of one game tick in cycles.
+ * @param target_divider Divider of the target frame rate, usually 1.
+ */
+void governor_init(uint32_t tick_cycles, uint8_t target_divider);
+
+/**
+ * @brief Counts a game tick and says whether it should be drawn.
+ *
+ * @return true if this tick is a frame.
+ */
+bool governor_tick(void);
+
+/**
+ * @brief Says whether optional work should be skipped this frame.
+ */
+bool governor_shed(void);
+
+/**
+ * @brief Feeds back the cost of the frame just drawn.
+ *
+ * @param render_cycles Cycles spent drawing.
+ */
+void governor_frame_done(uint32_t render_cycles);
+
+/**
+ * @brief Returns the frame-time statistics.
+ */
+const governor_stats_t *governor_get_stats(void);
+
+#endif
@@ -0,0 +1,289 @@
+#include "journal.h"
+
+#include <string.h>
+
+_Static_assert(sizeof(journal_block_t) == JOURNAL_BLOCK_SIZE, "journal block header changed size");
+
+// Worst case for one tick record: mask plus a 3-byte varint per field
+#define MAX_TICK_BYTES  (1 + JOURNAL_FIELDS * 3)
+#define MAX_RUN         255
+
+// Delta predictor, run identically by the writer and the decoder
+typedef struct
+{
+    int16_t history[JOURNAL_PERIOD][JOURNAL_FIELDS];   // past deltas
+    uint8_t slot;       // history entry JOURNAL_PERIOD ticks back
+    uint8_t periodic;   // bit i set: field i follows the periodic guess
+} journal_predictor_t;
+
+// Writer state, not part of the dumped journal
+typedef struct
+{
+    int16_t prev[JOURNAL_FIELDS];
+    journal_predictor_t pred;
+    uint8_t *run;       // count byte of the open run record, or NULL
+    bool restart;       // journal_restart() called since the last tick
+} journal_writer_t;
+
+static journal_t g_journal;
+static journal_writer_t g_writer;
+
+
+static void pack_fields(int16_t *f, const pong_state_t *s, const pong_vel_t *v)
+{
+    f[0] = s->l_x;  f[1] = s->l_y;
+    f[2] = s->r_x;  f[3] = s->r_y;
+    f[4] = s->b_x;  f[5] = s->b_y;
+    f[6] = v->b_dx; f[7] = v->b_dy;
+}
+
+static void unpack_fields(const int16_t *f, pong_state_t *s, pong_vel_t *v)
+{
+    s->l_x  = f[0]; s->l_y  = f[1];
+    s->r_x  = f[2]; s->r_y  = f[3];
+    s->b_x  = f[4]; s->b_y  = f[5];
+    v->b_dx = f[6]; v->b_dy = f[7];
+}
+
+static inline int16_t predict(const journal_predictor_t *p, uint32_t i)
+{
+    uint32_t last = (p->slot + JOURNAL_PERIOD - 1U) % JOURNAL_PERIOD;
+    return (p->periodic & (1U << i)) ? p->history[p->slot][i] : p->history[last][i];
+}
+
+static void predictor_update(journal_predictor_t *p, const int16_t *delta)
+{
+    uint32_t last = (p->slot + JOURNAL_PERIOD - 1U) % JOURNAL_PERIOD;
+
+    for(uint32_t i = 0; i < JOURNAL_FIELDS; ++i)
+    {
+        // Prefer the periodic guess; fall back to "same as last tick"
+        // only when that is the one that would have hit
+        if(delta[i] == p->history[p->slot][i])  p->periodic |= (uint8_t)(1U << i);
+        else if(delta[i] == p->history[last][i]) p->periodic &= (uint8_t)~(1U << i);
+
+        p->history[p->slot][i] = delta[i];
+    }
+
+    p->slot = (uint8_t)((p->slot + 1U) % JOURNAL_PERIOD);
+}
+
+static inline uint32_t zigzag_encode(int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t zigzag_decode(uint32_t v)
+{
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1U);
+}
+
+static uint8_t *put_varint(uint8_t *p, uint32_t v)
+{
+    while(v >= 0x80U)
+    {
+        *p++ = (uint8_t)(v | 0x80U);
+        v >>= 7;
+    }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+static const uint8_t *get_varint(const uint8_t *p, const uint8_t *end, uint32_t *out)
+{
+    uint32_t v = 0;
+    for(uint32_t shift = 0; shift < 32U; shift += 7U)
+    {
+        if(p == end) return NULL;
+        uint8_t b = *p++;
+        v |= (uint32_t)(b & 0x7FU) << shift;
+        if(!(b & 0x80U))
+        {
+            *out = v;
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static void start_block(const int16_t *f, const pong_state_t *s, const pong_vel_t *v)
+{
+    journal_block_t *blk = &g_journal.blocks[g_journal.cur];
+
+    blk->first_tick = g_journal.ticks;
+    blk->ticks = 1;
+    blk->used = 0;
+    blk->flags = g_writer.restart ? JOURNAL_BLOCK_RESTART : 0U;
+    blk->key_state = *s;
+    blk->key_vel = *v;
+
+    for(uint32_t i = 0; i < JOURNAL_FIELDS; ++i)
+    {
+        g_writer.prev[i] = f[i];
+    }
+    memset(&g_writer.pred, 0, sizeof(g_writer.pred));
+    g_writer.run = NULL;
+    g_writer.restart = false;
+}
+
+void journal_init(void)
+{
+    memset(&g_journal, 0, sizeof(g_journal));
+    memset(&g_writer, 0, sizeof(g_writer));
+
+    g_journal.magic = JOURNAL_MAGIC;
+    g_journal.version = JOURNAL_VERSION;
+    g_journal.block_size = JOURNAL_BLOCK_SIZE;
+    g_journal.block_count = JOURNAL_BLOCK_COUNT;
+}
+
+void journal_restart(void)
+{
+    g_writer.restart = true;
+}
+
+void journal_record(const pong_state_t *state, const pong_vel_t *vel)
+{
+    journal_block_t *blk = &g_journal.blocks[g_journal.cur];
+    int16_t f[JOURNAL_FIELDS];
+    pack_fields(f, state, vel);
+
+    if(blk->ticks == 0)
+    {
+        start_block(f, state, vel);
+        g_journal.ticks++;
+        return;
+    }
+
+    if(g_writer.restart)
+    {
+        // Move on, dropping the oldest block if the ring wrapped
+        g_journal.cur = (uint16_t)((g_journal.cur + 1U) % JOURNAL_BLOCK_COUNT);
+        start_block(f, state, vel);
+        g_journal.ticks++;
+        return;
+    }
+
+    int16_t delta[JOURNAL_FIELDS];
+    uint32_t res[JOURNAL_FIELDS];
+    uint8_t mask = 0;
+
+    for(uint32_t i = 0; i < JOURNAL_FIELDS; ++i)
+    {
+        delta[i] = (int16_t)(f[i] - g_writer.prev[i]);
+        res[i] = zigzag_encode((int16_t)(delta[i] - predict(&g_writer.pred, i)));
+        if(res[i]) mask |= (uint8_t)(1U << i);
+    }
+
+    if(mask == 0 && g_writer.run && *g_writer.run < MAX_RUN)
+    {
+        // Extend the open run in place
+        (*g_writer.run)++;
+    }
+    else
+    {
+        uint32_t need = mask ? MAX_TICK_BYTES : 2U;
+        if(blk->used + need > JOURNAL_PAYLOAD_SIZE)
+        {
+            // Block full: move on, dropping the oldest block if the ring wrapped
+            g_journal.cur = (uint16_t)((g_journal.cur + 1U) % JOURNAL_BLOCK_COUNT);
+            start_block(f, state, vel);
+            g_journal.ticks++;
+            return;
+        }
+
+        uint8_t *p = &blk->payload[blk->used];
+        *p++ = mask;
+
+        if(mask)
+        {
+            for(uint32_t i = 0; i < JOURNAL_FIELDS; ++i)
+            {
+                if(res[i]) p = put_varint(p, res[i]);
+            }
+            g_writer.run = NULL;
+        }
+        else
+        {
+            g_writer.run = p;
+            *p++ = 1;
+        }
+
+        blk->used = (uint16_t)(p - blk->payload);
+    }
+
+    blk->ticks++;
+    for(uint32_t i = 0; i < JOURNAL_FIELDS; ++i)
+    {
+        g_writer.prev[i] = f[i];
+    }
+    predictor_update(&g_writer.pred, delta);
+    g_journal.ticks++;
+}
+
+const journal_t *journal_get(void)
+{
+    return &g_journal;
+}
+
+int32_t journal_decode_block(const journal_block_t *block, journal_visit_fn visit, void *ctx)
+{
+    if(block->ticks == 0) return 0;
+    if(block->used > JOURNAL_PAYLOAD_SIZE) return -1;
+
+    int16_t f[JOURNAL_FIELDS];
+    journal_predictor_t pred;
+    pong_state_t s = block->key_state;
+    pong_vel_t v = block->key_vel;
+    uint32_t tick = block->first_tick;
+    int32_t decoded = 1;
+
+    memset(&pred, 0, sizeof(pred));
+    pack_fields(f, &s, &v);
+    if(!visit(tick, &s, &v, ctx)) return decoded;
+
+    const uint8_t *p = block->payload;
+    const uint8_t *end = block->payload + block->used;
+
+    while(p < end)
+    {
+        uint8_t mask = *p++;
+        uint32_t repeat = 1;
+        int16_t res[JOURNAL_FIELDS] = { 0 };
+
+        if(mask == 0)
+        {
+            if(p == end) return -1;
+            repeat = *p++;
+        }
+        else
+        {
+            for(uint32_t i = 0; i < JOURNAL_FIELDS; ++i)
+            {
+                if(!(mask & (1U << i))) continue;
+
+                uint32_t zz;
+                p = get_varint(p, end, &zz);
+                if(!p) return -1;
+                res[i] = (int16_t)zigzag_decode(zz);
+            }
+        }
+
+        while(repeat--)
+        {
+            int16_t delta[JOURNAL_FIELDS];
+            for(uint32_t i = 0; i < JOURNAL_FIELDS; ++i)
+            {
+                delta[i] = (int16_t)(predict(&pred, i) + res[i]);
+                f[i] = (int16_t)(f[i] + delta[i]);
+            }
+            predictor_update(&pred, delta);
+            unpack_fields(f, &s, &v);
+            ++tick;
+            ++decoded;
+            if(!visit(tick, &s, &v, ctx)) return decoded;
+        }
+    }
+
+    return decoded;
+}
@@ -0,0 +1,139 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pong.h"
+
+// Game-state journal.
+//
+// Each field's per-tick delta is predicted, and only the misses are
+// stored. The guess is either the last delta (constant motion) or the
+// delta from JOURNAL_PERIOD ticks back (the 2- and 3-tick stepping the
+// paddles fall into when they chase or sit on the ball), whichever hit
+// last for that field. Ticks where every guess hits are folded into run
+// records.
+//
+// Retention is about a minute, not hours. In CPU-against-CPU play every
+// rally brings a few unpredictable events (paddle starts and stops,
+// bounces), and a tick record costs at least two bytes, so the coding
+// averages about 1.1 bytes/tick: the default 16 x 256 B ring holds some
+// 3200 ticks, 51 s at FRAME_MS. History scales with JOURNAL_BLOCK_COUNT,
+// roughly a minute per 4 KB; `replay` prints the figure for a dump.
+//
+// The RAM ring is split into fixed blocks. Each block starts with a full
+// keyframe, so when the writer wraps around the oldest block is dropped
+// whole and every remaining block still decodes on its own.
+//
+// A jump pong_step() does not make itself, like the reset at a new round,
+// goes through journal_restart(): the next tick opens a new block flagged
+// JOURNAL_BLOCK_RESTART, so a replay starts over from its keyframe there
+// instead of checking it against the tick before. Earlier rounds stay in
+// the ring. The rest of the old block goes unused, about half a block
+// per round: with attract mode's 600-tick rounds the ring holds some 3100
+// ticks.
+//
+// Record format inside a block payload:
+//   0x00 <n>                  n ticks (1..255) where every prediction hit
+//   <mask> <varint>...        one tick; bit i of mask set means field i
+//                             missed, followed by zigzag varints of the
+//                             miss for each set bit, in order
+//
+// Field order: l_x, l_y, r_x, r_y, b_x, b_y, b_dx, b_dy.
+//
+// To pull the journal off a board:
+//   (gdb) dump binary value journal.bin 'journal.c'::g_journal
+
+#define JOURNAL_MAGIC        0x4A4E5050UL // "PPNJ"
+#define JOURNAL_VERSION      2
+#define JOURNAL_FIELDS       8
+#define JOURNAL_PERIOD       6
+
+#ifndef JOURNAL_BLOCK_SIZE
+#define JOURNAL_BLOCK_SIZE   256
+#endif
+
+#ifndef JOURNAL_BLOCK_COUNT
+#define JOURNAL_BLOCK_COUNT  16
+#endif
+
+#define JOURNAL_BLOCK_HEADER 28
+#define JOURNAL_PAYLOAD_SIZE (JOURNAL_BLOCK_SIZE - JOURNAL_BLOCK_HEADER)
+
+// Block flags
+#define JOURNAL_BLOCK_RESTART 0x0001U // keyframe follows a jump outside pong_step()
+
+typedef struct
+{
+    uint32_t first_tick;    // tick number of the keyframe
+    uint16_t ticks;         // ticks held in this block, keyframe included
+    uint16_t used;          // payload bytes written
+    uint16_t flags;         // JOURNAL_BLOCK_*
+    uint16_t reserved;
+    pong_state_t key_state; // keyframe
+    pong_vel_t key_vel;
+    uint8_t payload[JOURNAL_PAYLOAD_SIZE];
+} journal_block_t;
+
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t block_size;
+    uint16_t block_count;
+    uint16_t cur;           // block being written
+    uint32_t ticks;         // ticks recorded since journal_init()
+    journal_block_t blocks[JOURNAL_BLOCK_COUNT];
+} journal_t;
+
+/**
+ * @brief Called for every tick decoded from a block.
+ *
+ * @param tick  Tick number.
+ * @param state State after the tick.
+ * @param vel   Ball velocity after the tick.
+ * @param ctx   User pointer passed to journal_decode_block().
+ * @return false to stop decoding.
+ */
+typedef bool (*journal_visit_fn)(uint32_t tick, const pong_state_t *state,
+                                 const pong_vel_t *vel, void *ctx);
+
+/**
+ * @brief Clears the journal.
+ */
+void journal_init(void);
+
+/**
+ * @brief Starts a new block at the next tick, flagged as a restart.
+ *
+ * Call when the state jumps outside pong_step(), like at a new round.
+ */
+void journal_restart(void);
+
+/**
+ * @brief Appends one tick to the journal.
+ *
+ * Overwrites the oldest block when the ring is full.
+ *
+ * @param state State after the tick.
+ * @param vel   Ball velocity after the tick.
+ */
+void journal_record(const pong_state_t *state, const pong_vel_t *vel);
+
+/**
+ * @brief Returns the journal as it sits in RAM.
+ */
+const journal_t *journal_get(void);
+
+/**
+ * @brief Decodes every tick of one block, keyframe first.
+ *
+ * @param block Block to decode.
+ * @param visit Callback for each tick.
+ * @param ctx   Passed through to the callback.
+ * @return Number of ticks decoded, or -1 if the block is malformed.
+ */
+int32_t journal_decode_block(const journal_block_t *block, journal_visit_fn visit, void *ctx);
+
+#endif
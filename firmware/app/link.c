@@ -0,0 +1,278 @@
+#include "link.h"
+
+#include <string.h>
+
+#include "perf.h"
+#include "power.h"
+
+#ifndef HOST_BUILD
+#define LINK_RCC_AHB1ENR    (*(volatile uint32_t *)0x40023830UL)
+#define LINK_RCC_APB2ENR    (*(volatile uint32_t *)0x40023844UL)
+#define LINK_GPIOA_MODER    (*(volatile uint32_t *)0x40020000UL)
+#define LINK_GPIOA_AFRH     (*(volatile uint32_t *)0x40020024UL)
+#define LINK_USART1_BASE    0x40011000UL
+#define LINK_USART1_SR      (*(volatile uint32_t *)(LINK_USART1_BASE + 0x00UL))
+#define LINK_USART1_DR      (*(volatile uint32_t *)(LINK_USART1_BASE + 0x04UL))
+#define LINK_USART1_BRR     (*(volatile uint32_t *)(LINK_USART1_BASE + 0x08UL))
+#define LINK_USART1_CR1     (*(volatile uint32_t *)(LINK_USART1_BASE + 0x0CUL))
+#define LINK_NVIC_ISER1     (*(volatile uint32_t *)0xE000E104UL)
+
+#define LINK_AHB1ENR_GPIOA  (1U << 0)
+#define LINK_APB2ENR_USART1 (1U << 4)
+#define LINK_SR_ORE         (1U << 3)
+#define LINK_SR_RXNE        (1U << 5)
+#define LINK_SR_TC          (1U << 6)
+#define LINK_SR_TXE         (1U << 7)
+#define LINK_CR1_RE         (1U << 2)
+#define LINK_CR1_TE         (1U << 3)
+#define LINK_CR1_RXNEIE     (1U << 5)
+#define LINK_CR1_TXEIE      (1U << 7)
+#define LINK_CR1_UE         (1U << 13)
+#define LINK_USART1_IRQ     37U         // ISER1 bit 5
+#define LINK_PCLK2_HZ       PERF_CPU_HZ // APB2 x1 out of reset
+#endif
+
+typedef enum
+{
+    RX_SYNC = 0,
+    RX_TYPE,
+    RX_LEN,
+    RX_PAYLOAD,
+    RX_CRC
+} rx_state_t;
+
+static link_stats_t g_stats;
+
+// Parser
+static rx_state_t g_rx_state;
+static link_frame_t g_rx_frame;
+static uint8_t g_rx_got;
+static uint8_t g_rx_crc;
+
+#ifndef HOST_BUILD
+static uint8_t g_tx_ring[LINK_TX_RING];
+static volatile uint16_t g_tx_head;
+static volatile uint16_t g_tx_tail;
+static uint8_t g_rx_ring[LINK_RX_RING];
+static volatile uint16_t g_rx_head;
+static volatile uint16_t g_rx_tail;
+#endif
+
+
+#ifndef HOST_BUILD
+void USART1_Handler(void)
+{
+    uint32_t sr = LINK_USART1_SR;
+
+    // Reading DR after SR also clears an overrun
+    if(sr & (LINK_SR_RXNE | LINK_SR_ORE))
+    {
+        uint8_t b = (uint8_t)LINK_USART1_DR;
+        uint16_t next = (uint16_t)((g_rx_head + 1U) & (LINK_RX_RING - 1U));
+
+        if(sr & LINK_SR_ORE) g_stats.rx_overruns++;
+
+        if(next == g_rx_tail)
+        {
+            g_stats.rx_overruns++;
+        }
+        else
+        {
+            g_rx_ring[g_rx_head] = b;
+            g_rx_head = next;
+        }
+    }
+
+    if((sr & LINK_SR_TXE) && (LINK_USART1_CR1 & LINK_CR1_TXEIE))
+    {
+        if(g_tx_tail != g_tx_head)
+        {
+            LINK_USART1_DR = g_tx_ring[g_tx_tail];
+            g_tx_tail = (uint16_t)((g_tx_tail + 1U) & (LINK_TX_RING - 1U));
+        }
+        else
+        {
+            LINK_USART1_CR1 &= ~LINK_CR1_TXEIE;
+        }
+    }
+}
+#endif
+
+static uint8_t crc8(uint8_t crc, uint8_t b)
+{
+    crc ^= b;
+    for(uint8_t i = 0; i < 8; ++i)
+    {
+        crc = (uint8_t)((crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1);
+    }
+    return crc;
+}
+
+static uint32_t tx_free(void)
+{
+#ifdef HOST_BUILD
+    return LINK_TX_RING;
+#else
+    return (uint32_t)((g_tx_tail - g_tx_head - 1U) & (LINK_TX_RING - 1U));
+#endif
+}
+
+static void tx_bytes(const uint8_t *data, uint32_t len)
+{
+#ifdef HOST_BUILD
+    sim_uart_write(data, len);
+#else
+    for(uint32_t i = 0; i < len; ++i)
+    {
+        g_tx_ring[g_tx_head] = data[i];
+        g_tx_head = (uint16_t)((g_tx_head + 1U) & (LINK_TX_RING - 1U));
+    }
+    LINK_USART1_CR1 |= LINK_CR1_TXEIE;
+#endif
+    g_stats.tx_bytes += len;
+}
+
+static bool rx_byte(uint8_t *b)
+{
+#ifdef HOST_BUILD
+    return sim_uart_read(b, 1) == 1;
+#else
+    if(g_rx_tail == g_rx_head) return false;
+
+    *b = g_rx_ring[g_rx_tail];
+    g_rx_tail = (uint16_t)((g_rx_tail + 1U) & (LINK_RX_RING - 1U));
+    return true;
+#endif
+}
+
+void link_init(void)
+{
+    memset(&g_stats, 0, sizeof(g_stats));
+    g_rx_state = RX_SYNC;
+
+#ifndef HOST_BUILD
+    g_tx_head = g_tx_tail = 0;
+    g_rx_head = g_rx_tail = 0;
+
+    LINK_RCC_AHB1ENR |= LINK_AHB1ENR_GPIOA;
+    LINK_RCC_APB2ENR |= LINK_APB2ENR_USART1;
+    (void)LINK_RCC_APB2ENR;
+
+    // PA9/PA10 to AF7
+    LINK_GPIOA_MODER = (LINK_GPIOA_MODER & ~(0xFUL << 18)) | (0xAUL << 18);
+    LINK_GPIOA_AFRH = (LINK_GPIOA_AFRH & ~(0xFFUL << 4)) | (0x77UL << 4);
+
+    LINK_USART1_CR1 = 0;
+    LINK_USART1_BRR = (uint32_t)((LINK_PCLK2_HZ + LINK_BAUD / 2U) / LINK_BAUD);
+    LINK_USART1_CR1 = LINK_CR1_UE | LINK_CR1_TE | LINK_CR1_RE | LINK_CR1_RXNEIE;
+
+    LINK_NVIC_ISER1 = 1UL << (LINK_USART1_IRQ - 32U);
+#endif
+}
+
+bool link_send(uint8_t type, const uint8_t *payload, uint8_t len)
+{
+    uint8_t buf[LINK_MAX_PAYLOAD + 4];
+    uint8_t crc = 0;
+
+    if(len > LINK_MAX_PAYLOAD || tx_free() < len + 4U)
+    {
+        g_stats.tx_drops++;
+        return false;
+    }
+
+    buf[0] = LINK_SYNC;
+    buf[1] = type;
+    buf[2] = len;
+    memcpy(&buf[3], payload, len);
+
+    for(uint8_t i = 1; i < len + 3U; ++i) crc = crc8(crc, buf[i]);
+    buf[len + 3U] = crc;
+
+    tx_bytes(buf, len + 4U);
+    g_stats.tx_frames++;
+    return true;
+}
+
+bool link_poll(link_frame_t *frame)
+{
+    uint8_t b;
+
+    while(rx_byte(&b))
+    {
+        g_stats.rx_bytes++;
+
+        switch(g_rx_state)
+        {
+            case RX_SYNC:
+                if(b == LINK_SYNC) g_rx_state = RX_TYPE;
+                break;
+
+            case RX_TYPE:
+                g_rx_frame.type = b;
+                g_rx_crc = crc8(0, b);
+                g_rx_state = RX_LEN;
+                break;
+
+            case RX_LEN:
+                if(b > LINK_MAX_PAYLOAD)
+                {
+                    g_stats.bad_frames++;
+                    g_rx_state = (b == LINK_SYNC) ? RX_TYPE : RX_SYNC;
+                    break;
+                }
+                g_rx_frame.len = b;
+                g_rx_got = 0;
+                g_rx_crc = crc8(g_rx_crc, b);
+                g_rx_state = b ? RX_PAYLOAD : RX_CRC;
+                break;
+
+            case RX_PAYLOAD:
+                g_rx_frame.payload[g_rx_got++] = b;
+                g_rx_crc = crc8(g_rx_crc, b);
+                if(g_rx_got == g_rx_frame.len) g_rx_state = RX_CRC;
+                break;
+
+            case RX_CRC:
+                g_rx_state = RX_SYNC;
+                if(b != g_rx_crc)
+                {
+                    g_stats.bad_frames++;
+                    break;
+                }
+                *frame = g_rx_frame;
+                g_stats.rx_frames++;
+                return true;
+        }
+    }
+
+    return false;
+}
+
+void link_wait(uint32_t cycles)
+{
+#ifdef HOST_BUILD
+    sim_uart_wait(cycles);
+#else
+    // Bytes arriving meanwhile are buffered by the RX interrupt
+    power_sleep_until(power_now() + cycles);
+#endif
+}
+
+void link_flush(void)
+{
+#ifdef HOST_BUILD
+    sim_uart_flush();
+#else
+    while(g_tx_tail != g_tx_head);
+    // TXE only means the last byte reached the shift register; TC is set
+    // once its stop bit is out
+    while(!(LINK_USART1_SR & LINK_SR_TXE));
+    while(!(LINK_USART1_SR & LINK_SR_TC));
+#endif
+}
+
+const link_stats_t *link_get_stats(void)
+{
+    return &g_stats;
+}
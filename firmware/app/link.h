@@ -0,0 +1,82 @@
+#ifndef LINK_H
+#define LINK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Board-to-board serial link.
+//
+// USART1 on PA9 (TX) / PA10 (RX), crossed over between the two boards.
+// Both directions go through RAM rings serviced by the USART1 interrupt,
+// so sending a frame never waits on the wire.
+//
+// Frame format:
+//   0xA5 <type> <len> <payload: len bytes> <crc8>
+//
+// The CRC (polynomial 0x07) covers type, len and payload. The receiver
+// resynchronizes on the next 0xA5 after a bad frame.
+
+#define LINK_BAUD           115200UL
+#define LINK_SYNC           0xA5
+#define LINK_MAX_PAYLOAD    16
+#define LINK_TX_RING        256     // power of two
+#define LINK_RX_RING        256     // power of two
+
+typedef struct
+{
+    uint8_t type;
+    uint8_t len;
+    uint8_t payload[LINK_MAX_PAYLOAD];
+} link_frame_t;
+
+typedef struct
+{
+    uint32_t tx_bytes;
+    uint32_t rx_bytes;
+    uint32_t tx_frames;
+    uint32_t rx_frames;
+    uint32_t bad_frames;    // CRC or length errors
+    uint32_t tx_drops;      // frames dropped on a full TX ring
+    uint32_t rx_overruns;   // bytes lost on a full RX ring or USART overrun
+} link_stats_t;
+
+/**
+ * @brief Sets up USART1 and its pins and clears the rings.
+ */
+void link_init(void);
+
+/**
+ * @brief Queues one frame.
+ *
+ * @param type    Frame type.
+ * @param payload Payload bytes.
+ * @param len     Payload length, at most LINK_MAX_PAYLOAD.
+ * @return false if the frame did not fit in the TX ring and was dropped.
+ */
+bool link_send(uint8_t type, const uint8_t *payload, uint8_t len);
+
+/**
+ * @brief Parses received bytes up to the next complete frame.
+ *
+ * @param frame Receives the frame.
+ * @return true if a frame was received.
+ */
+bool link_poll(link_frame_t *frame);
+
+/**
+ * @brief Waits for incoming bytes for at most the given number of cycles.
+ */
+void link_wait(uint32_t cycles);
+
+/**
+ * @brief Waits until everything queued has gone out, the last stop bit
+ *        included, so the USART can be reconfigured or the core slept.
+ */
+void link_flush(void);
+
+/**
+ * @brief Returns the byte and frame counters.
+ */
+const link_stats_t *link_get_stats(void);
+
+#endif
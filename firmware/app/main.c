@@ -1,7 +1,44 @@
 #include "pong.h"
 
+#ifdef STRESS_BALLS
+#include "balls.h"
+#endif
+
+#ifdef LINK_PLAY
+#include "netplay.h"
+#endif
+
+#ifdef ILI9341_MIRROR
+#include "mirror.h"
+#endif
+
+#ifdef DISPLAY_BENCH
+#include "bench.h"
+#endif
+
+#ifdef ILI9341_SPI_QUEUE
+#include "spiq.h"
+#endif
+
 int main(void)
 {
+#ifdef ILI9341_MIRROR
+    mirror_init();
+#endif
     pong_init();
+#ifdef ILI9341_SPI_QUEUE
+    spiq_init();
+#endif
+
+#ifdef STRESS_BALLS
+    balls_play(STRESS_BALLS);
+#elif defined(LINK_PLAY)
+    netplay_play();
+#elif defined(DISPLAY_BENCH)
+    bench_play();
+#elif defined(ATTRACT_MODE)
+    pong_attract();
+#else
     pong_play();
+#endif
 }
@@ -0,0 +1,400 @@
+#include "netplay.h"
+
+#include <string.h>
+
+#include "ai.h"
+#include "arena.h"
+#include "link.h"
+#include "perf.h"
+#include "power.h"
+
+#define HISTORY_MASK    (NETPLAY_HISTORY - 1U)
+#define NO_TICK         0xFFFFFFFFUL
+#define CHECK_SLOTS     4
+#define WAIT_CYCLES     PERF_US_TO_CYCLES(1000)
+
+typedef struct
+{
+    pong_state_t state;
+    pong_vel_t vel;
+} snapshot_t;
+
+typedef struct
+{
+    uint32_t tick;
+    uint16_t hash;
+} check_t;
+
+static netplay_stats_t g_stats;
+
+static pong_state_t g_cur;
+static pong_vel_t g_vel;
+static pong_state_t g_shown;
+
+// Indexed by tick & HISTORY_MASK
+static snapshot_t g_snap[NETPLAY_HISTORY];      // state at the start of the tick
+static int8_t g_local[NETPLAY_HISTORY];
+static int8_t g_remote[NETPLAY_HISTORY];
+static uint32_t g_remote_tick[NETPLAY_HISTORY]; // tick g_remote holds, or NO_TICK
+static int8_t g_used[NETPLAY_HISTORY];          // peer input the last step used
+
+static uint32_t g_rollback_from;                // earliest mispredicted tick, or NO_TICK
+static uint32_t g_last_rx;                      // power_now() of the last peer frame
+
+static uint32_t g_next_check;                   // next tick whose state gets hashed
+static check_t g_mine[CHECK_SLOTS];
+static check_t g_theirs[CHECK_SLOTS];
+
+
+static uint16_t hash_state(const pong_state_t *state, const pong_vel_t *vel)
+{
+    // FNV-1a over the raw fields, folded to 16 bits
+    uint32_t h = 2166136261UL;
+    const uint8_t *p = (const uint8_t *)state;
+
+    for(uint32_t i = 0; i < sizeof(*state); ++i) h = (h ^ p[i]) * 16777619UL;
+    p = (const uint8_t *)vel;
+    for(uint32_t i = 0; i < sizeof(*vel); ++i) h = (h ^ p[i]) * 16777619UL;
+
+    return (uint16_t)(h ^ (h >> 16));
+}
+
+// Widens a 16-bit tick from the wire to the full tick nearest to ref
+static uint32_t widen_tick(uint16_t wire, uint32_t ref)
+{
+    return ref + (uint32_t)(int32_t)(int16_t)(uint16_t)(wire - (uint16_t)ref);
+}
+
+static bool remote_known(uint32_t tick)
+{
+    return g_remote_tick[tick & HISTORY_MASK] == tick;
+}
+
+// Peer input for a tick: the real one if it is in, else the last one seen
+static int8_t remote_input(uint32_t tick)
+{
+    if(remote_known(tick)) return g_remote[tick & HISTORY_MASK];
+    if(g_stats.confirmed == 0) return 0;
+    return g_remote[(g_stats.confirmed - 1U) & HISTORY_MASK];
+}
+
+static void step(uint32_t tick)
+{
+    const uint32_t i = tick & HISTORY_MASK;
+    int8_t remote = remote_input(tick);
+    pong_input_t input;
+
+    g_snap[i].state = g_cur;
+    g_snap[i].vel = g_vel;
+    g_used[i] = remote;
+
+    input.l_dy = g_stats.left ? g_local[i] : remote;
+    input.r_dy = g_stats.left ? remote : g_local[i];
+    pong_step(&g_cur, &g_vel, &input);
+}
+
+static void compare_checks(uint32_t slot)
+{
+    if(g_mine[slot].tick != NO_TICK && g_mine[slot].tick == g_theirs[slot].tick)
+    {
+        g_stats.checks++;
+        if(g_mine[slot].hash != g_theirs[slot].hash) g_stats.desyncs++;
+        g_theirs[slot].tick = NO_TICK;
+    }
+}
+
+static void on_input(const link_frame_t *frame)
+{
+    if(frame->len != 2U + NETPLAY_REDUNDANCY) return;
+
+    uint16_t wire = (uint16_t)(frame->payload[0] | (frame->payload[1] << 8));
+    uint32_t last = widen_tick(wire, g_stats.confirmed);
+
+    for(uint32_t n = 0; n < NETPLAY_REDUNDANCY; ++n)
+    {
+        uint32_t tick = last - (NETPLAY_REDUNDANCY - 1U) + n;
+        int8_t input = (int8_t)frame->payload[2 + n];
+
+        // Already known, or too far ahead to have a slot yet
+        if((int32_t)(tick - g_stats.confirmed) < 0 || remote_known(tick)) continue;
+        if(tick - g_stats.confirmed >= NETPLAY_HISTORY - NETPLAY_MAX_ROLLBACK) continue;
+
+        g_remote[tick & HISTORY_MASK] = input;
+        g_remote_tick[tick & HISTORY_MASK] = tick;
+
+        // Already stepped with a wrong guess
+        if(tick < g_stats.tick && g_used[tick & HISTORY_MASK] != input &&
+           (g_rollback_from == NO_TICK || tick < g_rollback_from))
+        {
+            g_rollback_from = tick;
+        }
+    }
+
+    while(remote_known(g_stats.confirmed)) g_stats.confirmed++;
+}
+
+static void on_check(const link_frame_t *frame)
+{
+    if(frame->len != 4) return;
+
+    uint16_t wire = (uint16_t)(frame->payload[0] | (frame->payload[1] << 8));
+    uint32_t tick = widen_tick(wire, g_stats.confirmed);
+    uint32_t slot = (tick / NETPLAY_CHECK_PERIOD) % CHECK_SLOTS;
+
+    g_theirs[slot].tick = tick;
+    g_theirs[slot].hash = (uint16_t)(frame->payload[2] | (frame->payload[3] << 8));
+    compare_checks(slot);
+}
+
+static void receive(void)
+{
+    link_frame_t frame;
+
+    while(link_poll(&frame))
+    {
+        g_last_rx = power_now();
+
+        if(frame.type == NETPLAY_FRAME_INPUT) on_input(&frame);
+        else if(frame.type == NETPLAY_FRAME_CHECK) on_check(&frame);
+    }
+}
+
+// The simulated clock only moves for bus and link time, so on the host
+// rollbacks are timed on the host's own clock instead
+static inline uint32_t resim_clock(void)
+{
+#ifdef HOST_BUILD
+    return (uint32_t)sim_host_ns();
+#else
+    return perf_cycles();
+#endif
+}
+
+static void rollback(void)
+{
+    if(g_rollback_from == NO_TICK) return;
+
+    uint32_t start = resim_clock();
+    uint32_t from = g_rollback_from;
+    uint16_t depth = (uint16_t)(g_stats.tick - from);
+
+    g_cur = g_snap[from & HISTORY_MASK].state;
+    g_vel = g_snap[from & HISTORY_MASK].vel;
+    for(uint32_t tick = from; tick < g_stats.tick; ++tick) step(tick);
+
+    g_rollback_from = NO_TICK;
+
+    g_stats.rollbacks++;
+    g_stats.resim_ticks += depth;
+    g_stats.depth_last = depth;
+    if(depth > g_stats.depth_max) g_stats.depth_max = depth;
+    g_stats.depth_hist[depth <= NETPLAY_MAX_ROLLBACK ? depth : NETPLAY_MAX_ROLLBACK]++;
+    g_stats.resim_cycles_last = resim_clock() - start;
+    g_stats.resim_cycles += g_stats.resim_cycles_last;
+    if(g_stats.resim_cycles_last > g_stats.resim_cycles_max)
+    {
+        g_stats.resim_cycles_max = g_stats.resim_cycles_last;
+    }
+}
+
+// Sends the hash of the newest agreed state that is due a check
+static void send_check(void)
+{
+    // The state at the start of a tick is final once every input before it is in
+    if(g_stats.confirmed < g_next_check || g_stats.tick < g_next_check) return;
+
+    uint32_t tick = g_next_check;
+    uint32_t slot = (tick / NETPLAY_CHECK_PERIOD) % CHECK_SLOTS;
+    const snapshot_t *snap = &g_snap[tick & HISTORY_MASK];
+    uint16_t hash = (tick == g_stats.tick) ? hash_state(&g_cur, &g_vel)
+                                           : hash_state(&snap->state, &snap->vel);
+    uint8_t p[4] = {
+        (uint8_t)tick, (uint8_t)(tick >> 8),
+        (uint8_t)hash, (uint8_t)(hash >> 8)
+    };
+
+    link_send(NETPLAY_FRAME_CHECK, p, sizeof(p));
+    g_mine[slot].tick = tick;
+    g_mine[slot].hash = hash;
+    compare_checks(slot);
+
+    g_next_check += NETPLAY_CHECK_PERIOD;
+}
+
+static void send_input(void)
+{
+    const uint32_t last = g_stats.tick + NETPLAY_INPUT_DELAY;
+    uint8_t p[2 + NETPLAY_REDUNDANCY];
+
+    p[0] = (uint8_t)last;
+    p[1] = (uint8_t)(last >> 8);
+    for(uint32_t n = 0; n < NETPLAY_REDUNDANCY; ++n)
+    {
+        // Ticks before the first one go out as zero
+        uint32_t tick = last - (NETPLAY_REDUNDANCY - 1U) + n;
+        p[2 + n] = (last + 1U + n >= NETPLAY_REDUNDANCY) ? (uint8_t)g_local[tick & HISTORY_MASK] : 0;
+    }
+
+    link_send(NETPLAY_FRAME_INPUT, p, sizeof(p));
+}
+
+// Ticks simulated past the peer's inputs; negative when the peer is ahead
+static int32_t ahead(void)
+{
+    return (int32_t)(g_stats.tick - g_stats.confirmed);
+}
+
+static bool peer_quiet(void)
+{
+    return power_now() - g_last_rx > PERF_MS_TO_CYCLES(NETPLAY_TIMEOUT_MS);
+}
+
+bool netplay_init(uint16_t nonce)
+{
+    uint32_t start = power_now();
+    uint32_t next_hello = start;
+    bool heard = false;
+    uint16_t peer = 0;
+
+    link_init();
+
+    for(;;)
+    {
+        link_frame_t frame;
+
+        if(perf_reached(power_now(), next_hello))
+        {
+            uint8_t p[3] = { (uint8_t)nonce, (uint8_t)(nonce >> 8), heard };
+            link_send(NETPLAY_FRAME_HELLO, p, sizeof(p));
+            next_hello = power_now() + PERF_MS_TO_CYCLES(NETPLAY_HELLO_MS);
+        }
+
+        // Stop at the frame that completes the handshake; the peer's
+        // inputs may follow right behind it
+        bool done = false;
+        while(!done && link_poll(&frame))
+        {
+            if(frame.type != NETPLAY_FRAME_HELLO || frame.len != 3) continue;
+
+            peer = (uint16_t)(frame.payload[0] | (frame.payload[1] << 8));
+            heard = true;
+            if(frame.payload[2]) done = true;
+        }
+
+        if(done)
+        {
+            // Tell the peer in case it has not seen our heard flag yet
+            uint8_t p[3] = { (uint8_t)nonce, (uint8_t)(nonce >> 8), 1 };
+            link_send(NETPLAY_FRAME_HELLO, p, sizeof(p));
+            break;
+        }
+
+        if(power_now() - start > PERF_MS_TO_CYCLES(NETPLAY_TIMEOUT_MS)) return false;
+        link_wait(WAIT_CYCLES);
+    }
+
+    if(peer == nonce) return false;
+
+    memset(&g_stats, 0, sizeof(g_stats));
+    memset(g_local, 0, sizeof(g_local));
+    for(uint32_t i = 0; i < NETPLAY_HISTORY; ++i) g_remote_tick[i] = NO_TICK;
+    for(uint32_t i = 0; i < CHECK_SLOTS; ++i) g_mine[i].tick = g_theirs[i].tick = NO_TICK;
+
+    g_stats.left = nonce < peer;
+    g_rollback_from = NO_TICK;
+    g_next_check = NETPLAY_CHECK_PERIOD;
+    g_last_rx = power_now();
+
+    pong_reset(&g_cur, &g_vel);
+    g_shown = g_cur;
+    pong_draw_field(&g_cur);
+
+    return true;
+}
+
+bool netplay_tick(void)
+{
+    receive();
+
+    // Don't run further ahead of the peer than a rollback can undo
+    if(ahead() >= NETPLAY_MAX_ROLLBACK)
+    {
+        uint32_t start = power_now();
+
+        g_stats.stalls++;
+        while(ahead() >= NETPLAY_MAX_ROLLBACK)
+        {
+            if(peer_quiet()) return false;
+            link_wait(WAIT_CYCLES);
+            receive();
+        }
+        g_stats.stall_cycles += power_now() - start;
+    }
+
+    rollback();
+    send_check();
+
+    // Local paddle: the AI plays this board's side
+    pong_input_t ai;
+    ai_update(&g_cur, &g_vel, &ai);
+    g_local[(g_stats.tick + NETPLAY_INPUT_DELAY) & HISTORY_MASK] = (int8_t)(g_stats.left ? ai.l_dy : ai.r_dy);
+    send_input();
+
+    step(g_stats.tick);
+    g_stats.tick++;
+
+    pong_draw_frame(&g_shown, &g_cur);
+    g_shown = g_cur;
+
+    return !peer_quiet();
+}
+
+bool netplay_sync(void)
+{
+    link_flush();
+
+    while(ahead() > 0)
+    {
+        if(peer_quiet()) return false;
+        link_wait(WAIT_CYCLES);
+        receive();
+    }
+
+    rollback();
+    send_check();
+    link_flush();
+    return true;
+}
+
+uint16_t netplay_hash(void)
+{
+    return hash_state(&g_cur, &g_vel);
+}
+
+const pong_state_t *netplay_state(void)
+{
+    return &g_cur;
+}
+
+const netplay_stats_t *netplay_get_stats(void)
+{
+    return &g_stats;
+}
+
+void netplay_play(void)
+{
+    const uint32_t tick_cycles = PERF_MS_TO_CYCLES(FRAME_MS);
+
+    for(;;)
+    {
+        while(!netplay_init((uint16_t)perf_cycles()));
+
+        uint32_t deadline = power_now();
+        do
+        {
+            deadline += tick_cycles;
+            power_frame_idle(deadline);
+            arena_frame_reset();
+        } while(netplay_tick());
+    }
+}
@@ -0,0 +1,119 @@
+#ifndef NETPLAY_H
+#define NETPLAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pong.h"
+
+// Two-board play over the serial link (link.h).
+//
+// Each board runs the whole game and drives one paddle; the other paddle
+// is the peer's. Every tick a board sends its paddle input for that tick
+// (plus the few before it, so a lost frame costs nothing) and steps the
+// game at once, guessing that the peer's input is the same as the last
+// one it received. States at the start of recent ticks are kept. When a
+// peer input arrives that differs from the guess, the game is rolled back
+// to that tick and stepped forward again with the real input; pong_step()
+// is deterministic, so both boards end up with the same state.
+//
+// A board never runs more than NETPLAY_MAX_ROLLBACK ticks past the last
+// tick it has the peer's input for; beyond that it waits for the link.
+// Local inputs can be delayed by NETPLAY_INPUT_DELAY ticks, which trades
+// input latency for fewer rollbacks.
+//
+// Both boards send a hash of the agreed state every NETPLAY_CHECK_PERIOD
+// ticks so a desync is noticed.
+//
+// Link frames:
+//   HELLO  nonce(u16) heard(u8)           handshake; lower nonce plays left
+//   INPUT  tick(u16) input(s8) x 4        inputs for tick-3..tick
+//   CHECK  tick(u16) hash(u16)            state at the start of tick
+
+#define NETPLAY_HISTORY       32    // ticks of state and input kept, power of two
+#define NETPLAY_MAX_ROLLBACK  8
+#define NETPLAY_REDUNDANCY    4     // inputs per INPUT frame
+#define NETPLAY_CHECK_PERIOD  32
+#define NETPLAY_TIMEOUT_MS    2000
+#define NETPLAY_HELLO_MS      50
+
+#ifndef NETPLAY_INPUT_DELAY
+#define NETPLAY_INPUT_DELAY   0
+#endif
+
+#define NETPLAY_FRAME_HELLO   1
+#define NETPLAY_FRAME_INPUT   2
+#define NETPLAY_FRAME_CHECK   3
+
+typedef struct
+{
+    bool left;                  // this board plays the left paddle
+    uint32_t tick;              // next tick to simulate
+    uint32_t confirmed;         // ticks with the peer's input known
+
+    uint32_t rollbacks;
+    uint32_t resim_ticks;       // ticks stepped again by rollbacks
+    uint16_t depth_last;        // ticks rolled back, last rollback
+    uint16_t depth_max;
+    uint32_t depth_hist[NETPLAY_MAX_ROLLBACK + 1];
+    uint32_t resim_cycles_last; // cost of the last rollback (host: ns)
+    uint32_t resim_cycles_max;
+    uint64_t resim_cycles;      // all rollbacks, for the average
+
+    uint32_t stalls;            // ticks that had to wait for the peer
+    uint32_t stall_cycles;
+    uint32_t checks;            // state hashes compared
+    uint32_t desyncs;           // of those, mismatches
+} netplay_stats_t;
+
+/**
+ * @brief Finds the peer and agrees on sides, then resets the game.
+ *
+ * pong_init() must have run. Draws the field once both boards are ready.
+ *
+ * @param nonce Board-specific value; the lower one plays left.
+ * @return false if no peer answered in NETPLAY_TIMEOUT_MS, or both
+ *         boards picked the same nonce.
+ */
+bool netplay_init(uint16_t nonce);
+
+/**
+ * @brief Runs one tick: reads the link, rolls back if needed, sends the
+ *        local input, steps and draws.
+ *
+ * Waits for the peer if it is NETPLAY_MAX_ROLLBACK ticks behind.
+ *
+ * @return false if the peer has gone quiet for NETPLAY_TIMEOUT_MS.
+ */
+bool netplay_tick(void);
+
+/**
+ * @brief Waits until the peer's inputs for every simulated tick are in
+ *        and the state is final.
+ *
+ * @return false on timeout.
+ */
+bool netplay_sync(void);
+
+/**
+ * @brief Returns a hash of the current state and ball velocity.
+ */
+uint16_t netplay_hash(void);
+
+/**
+ * @brief Returns the current state.
+ */
+const pong_state_t *netplay_state(void);
+
+/**
+ * @brief Returns the rollback and link-wait counters.
+ */
+const netplay_stats_t *netplay_get_stats(void);
+
+/**
+ * @brief Plays against the linked board forever, retrying the handshake
+ *        until a peer shows up.
+ */
+void netplay_play(void);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Core clock. The app runs from the 16 MHz HSI out of reset.
+#define PERF_CPU_HZ 16000000UL
+
+#define PERF_MS_TO_CYCLES(ms) ((uint32_t)(ms) * (uint32_t)(PERF_CPU_HZ / 1000UL))
+#define PERF_US_TO_CYCLES(us) ((uint32_t)(us) * (uint32_t)(PERF_CPU_HZ / 1000000UL))
+
+#ifdef HOST_BUILD
+
+#include "sim.h"
+
+static inline uint32_t perf_cycles(void) { return (uint32_t)sim_cycles(); }
+
+#else
+
+// DWT cycle counter, enabled by dwt_init()
+#define PERF_DWT_CYCCNT (*(volatile uint32_t *)0xE0001004UL)
+
+static inline uint32_t perf_cycles(void) { return PERF_DWT_CYCCNT; }
+
+#endif
+
+/**
+ * @brief Returns true once the cycle counter has reached a deadline.
+ *
+ * Safe across counter wrap as long as the deadline is less than
+ * 2^31 cycles away.
+ */
+static inline bool perf_reached(uint32_t now, uint32_t deadline)
+{
+    return (int32_t)(now - deadline) >= 0;
+}
+
+#endif
@@ -1,11 +1,20 @@
 #include "pong.h"
 
+#include "ai.h"
+#include "arena.h"
 #include "f446re.h"
 #include "ili9341.h"
+#include "governor.h"
+#include "journal.h"
+#include "perf.h"
+#include "power.h"
+#include "scroll.h"
+#include "sprites.h"
 
 
 static pong_state_t g_pstate;
 static pong_state_t g_cstate;
+static pong_vel_t g_vel;
 static int16_t g_screen_w;
 static int16_t g_screen_h;
 static int16_t g_pad_w;
@@ -13,7 +22,21 @@ static int16_t g_pad_h;
 static int16_t g_ball_w;
 static int16_t g_ball_h;
 
-static void draw_initial_state(void);
+// Center-line repair deferred by the governor
+static bool g_line_dirty;
+static uint16_t g_line_dirty_y0;
+static uint16_t g_line_dirty_y1;
+
+// Deadline of the current tick, kept across pong_run() calls
+static uint32_t g_deadline;
+
+static const ai_config_t g_ai_config = {
+    .reaction_ticks = AI_REACTION_TICKS,
+    .error_px = AI_ERROR_PX,
+    .seed = 1
+};
+
+static void draw_initial_state(const pong_state_t *state);
 static void draw_center_line(void);
 
 
@@ -75,60 +98,88 @@ void pong_init(void)
     ili9341_init(&ili_config);
 
     ili9341_get_screen_size((uint16_t *)&g_screen_w, (uint16_t *)&g_screen_h);
+    sprites_init();
     g_pad_w = PADDLE_W;
     g_pad_h = PADDLE_H;
     g_ball_w = BALL_SIZE;
     g_ball_h = BALL_SIZE;
 
-    g_pstate.l_x = 3; // 3 pixels of padding
-    g_pstate.l_y = (g_screen_h / 2) - (g_pad_h) / 2;
+    pong_reset(&g_cstate, &g_vel);
+    g_pstate = g_cstate;
+
+    ai_init(&g_ai_config, g_screen_h);
+
+    journal_init();
+    power_init();
+    governor_init(PERF_MS_TO_CYCLES(FRAME_MS), 1);
+    g_deadline = power_now();
+
+    pong_draw_field(&g_cstate);
+}
+
+void pong_reset(pong_state_t *state, pong_vel_t *vel)
+{
+    state->l_x = 3; // 3 pixels of padding
+    state->l_y = (g_screen_h / 2) - (g_pad_h) / 2;
 
-    g_pstate.r_x = (int16_t)(g_screen_w - g_pad_w - 3); // 3 pixels of padding
-    g_pstate.r_y = g_pstate.l_y;
+    state->r_x = (int16_t)(g_screen_w - g_pad_w - 3); // 3 pixels of padding
+    state->r_y = state->l_y;
 
-    g_pstate.b_x = (g_screen_w / 2) - (g_ball_w / 2);
-    g_pstate.b_y = (g_screen_h / 2) - (g_ball_h / 2);
+    state->b_x = (g_screen_w / 2) - (g_ball_w / 2);
+    state->b_y = (g_screen_h / 2) - (g_ball_h / 2);
 
-    g_cstate = g_pstate;
+    vel->b_dx = 3;
+    vel->b_dy = 2;
+}
 
+void pong_draw_field(const pong_state_t *state)
+{
     ili9341_fill_screen(COLOR_BLACK);
 
-    draw_initial_state();
+    draw_initial_state(state);
     draw_center_line();
 }
 
-void draw_initial_state(void)
+void draw_initial_state(const pong_state_t *state)
 {
     // Ball
-    ili9341_fill_rect((uint16_t)g_cstate.b_x,
-                      (uint16_t)g_cstate.b_y,
+    ili9341_fill_rect((uint16_t)state->b_x,
+                      (uint16_t)state->b_y,
                       (uint16_t)g_ball_w,
                       (uint16_t)g_ball_h,
                       COLOR_WHITE);
     // Left paddle
-    ili9341_fill_rect((uint16_t)g_cstate.l_x,
-                      (uint16_t)g_cstate.l_y,
+    ili9341_fill_rect((uint16_t)state->l_x,
+                      (uint16_t)state->l_y,
                       (uint16_t)g_pad_w,
                       (uint16_t)g_pad_h,
                       COLOR_WHITE);
 
     // right paddle
-    ili9341_fill_rect((uint16_t)g_cstate.r_x,
-                      (uint16_t)g_cstate.r_y,
+    ili9341_fill_rect((uint16_t)state->r_x,
+                      (uint16_t)state->r_y,
                       (uint16_t)g_pad_w,
                       (uint16_t)g_pad_h,
                       COLOR_WHITE);
 }
 
+static bool overlaps_center_line(uint16_t x, uint16_t w)
+{
+    const uint16_t line_x   = (uint16_t)(g_screen_w / 2 - 1);
+    const uint16_t line_w   = CENTER_LINE_W;
+
+    return !(x > line_x + line_w || x + w < line_x);
+}
+
 static void restore_center_line_segment(uint16_t x, uint16_t y, uint16_t w, uint16_t h)
 {
-    const uint16_t dash_h   = 8;
-    const uint16_t gap_h    = 4;
+    const uint16_t dash_h   = CENTER_DASH_H;
+    const uint16_t gap_h    = CENTER_GAP_H;
     const uint16_t line_x   = (uint16_t)(g_screen_w / 2 - 1);
-    const uint16_t line_w   = 2;
+    const uint16_t line_w   = CENTER_LINE_W;
 
     // Only do anything if overlap with center line
-    if(x > line_x + line_w || x + w < line_x) return;
+    if(!overlaps_center_line(x, w)) return;
 
     // Redraw dashes overlapping the erased area
     uint16_t y_end = y + h;
@@ -144,68 +195,63 @@ static void restore_center_line_segment(uint16_t x, uint16_t y, uint16_t w, uint
     }
 }
 
-static void draw_left_paddle(void)
+static void draw_left_paddle(const pong_state_t *prev, const pong_state_t *cur)
 {
-    // Erase old
-    ili9341_fill_rect((uint16_t)g_pstate.l_x,
-                      (uint16_t)g_pstate.l_y,
-                      (uint16_t)g_pad_w,
-                      (uint16_t)g_pad_h,
-                      COLOR_BLACK);
-
-    // Draw new
-    ili9341_fill_rect((uint16_t)g_cstate.l_x,
-                      (uint16_t)g_cstate.l_y,
-                      (uint16_t)g_pad_w,
-                      (uint16_t)g_pad_h,
-                      COLOR_WHITE);
+    sprites_draw(SPRITE_PADDLE, prev->l_x, prev->l_y, false);  // Erase old
+    sprites_draw(SPRITE_PADDLE, cur->l_x, cur->l_y, true);     // Draw new
 }
 
-static void draw_right_paddle(void)
+static void draw_right_paddle(const pong_state_t *prev, const pong_state_t *cur)
 {
-    // Erase old
-    ili9341_fill_rect((uint16_t)g_pstate.r_x,
-                      (uint16_t)g_pstate.r_y,
-                      (uint16_t)g_pad_w,
-                      (uint16_t)g_pad_h,
-                      COLOR_BLACK);
-
-    // Draw new
-    ili9341_fill_rect((uint16_t)g_cstate.r_x,
-                      (uint16_t)g_cstate.r_y,
-                      (uint16_t)g_pad_w,
-                      (uint16_t)g_pad_h,
-                      COLOR_WHITE);
+    sprites_draw(SPRITE_PADDLE, prev->r_x, prev->r_y, false);  // Erase old
+    sprites_draw(SPRITE_PADDLE, cur->r_x, cur->r_y, true);     // Draw new
 }
 
-static void draw_ball(void)
+static void draw_ball(const pong_state_t *prev, const pong_state_t *cur)
 {
     // Erase old
-    ili9341_fill_rect((uint16_t)g_pstate.b_x,
-                      (uint16_t)g_pstate.b_y,
-                      (uint16_t)g_ball_w,
-                      (uint16_t)g_ball_h,
-                      COLOR_BLACK);
+    sprites_draw(SPRITE_BALL, prev->b_x, prev->b_y, false);
 
-    restore_center_line_segment((uint16_t)g_pstate.b_x,
-                                (uint16_t)g_pstate.b_y,
-                                (uint16_t)g_ball_w,
-                                (uint16_t)g_ball_h);
+    if(governor_shed())
+    {
+        // Over budget: leave the hole in the center line for a later frame
+        if(overlaps_center_line((uint16_t)prev->b_x, (uint16_t)g_ball_w))
+        {
+            uint16_t y0 = (uint16_t)prev->b_y;
+            uint16_t y1 = (uint16_t)(prev->b_y + g_ball_h);
+
+            if(!g_line_dirty || y0 < g_line_dirty_y0) g_line_dirty_y0 = y0;
+            if(!g_line_dirty || y1 > g_line_dirty_y1) g_line_dirty_y1 = y1;
+            g_line_dirty = true;
+        }
+    }
+    else
+    {
+        restore_center_line_segment((uint16_t)prev->b_x,
+                                    (uint16_t)prev->b_y,
+                                    (uint16_t)g_ball_w,
+                                    (uint16_t)g_ball_h);
+
+        if(g_line_dirty)
+        {
+            restore_center_line_segment((uint16_t)(g_screen_w / 2 - 1),
+                                        g_line_dirty_y0,
+                                        CENTER_LINE_W,
+                                        (uint16_t)(g_line_dirty_y1 - g_line_dirty_y0));
+            g_line_dirty = false;
+        }
+    }
 
     // Draw new
-    ili9341_fill_rect((uint16_t)g_cstate.b_x,
-                      (uint16_t)g_cstate.b_y,
-                      (uint16_t)g_ball_w,
-                      (uint16_t)g_ball_h,
-                      COLOR_WHITE);
+    sprites_draw(SPRITE_BALL, cur->b_x, cur->b_y, true);
 }
 
 static void draw_center_line(void)
 {
-    const uint16_t dash_h   = 8;   // height of each dash
-    const uint16_t gap_h    = 4;   // gap between dashes
+    const uint16_t dash_h   = CENTER_DASH_H;   // height of each dash
+    const uint16_t gap_h    = CENTER_GAP_H;   // gap between dashes
     const uint16_t line_x   = (uint16_t)(g_screen_w / 2 - 1); // 1-px line centered
-    const uint16_t line_w   = 2;   // thickness
+    const uint16_t line_w   = CENTER_LINE_W;   // thickness
 
     for(uint16_t y = 0; y < g_screen_h; y += (dash_h + gap_h))
     {
@@ -217,86 +263,252 @@ static void draw_center_line(void)
     }
 }
 
-void pong_play(void)
+void pong_draw_frame(const pong_state_t *prev, const pong_state_t *cur)
 {
-    dwt_delay_ms(100);
+    draw_left_paddle(prev, cur);
+    draw_right_paddle(prev, cur);
+    draw_ball(prev, cur);
+}
 
-    // Ball velocity
-    int16_t b_dx = 3;
-    int16_t b_dy = 2;
+// Draws the part of a field rectangle that falls in field lines
+// source .. source + count - 1 into drawing lines from `line` on
+static void paint_rect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color,
+                       uint16_t line, uint16_t count, uint16_t source)
+{
+    const bool horizontal = ili9341_scroll_horizontal();
+    int32_t a0 = horizontal ? x : y;
+    int32_t a1 = a0 + (horizontal ? w : h);
 
-    while(1)
-    {
-        g_pstate = g_cstate; // save old state
+    if(a0 < source) a0 = source;
+    if(a1 > source + count) a1 = source + count;
+    if(a0 >= a1) return;
 
-        // --- Move ball ---
-        g_cstate.b_x += b_dx;
-        g_cstate.b_y += b_dy;
+    uint16_t at = (uint16_t)(line + (a0 - source));
+    uint16_t n = (uint16_t)(a1 - a0);
+
+    if(horizontal) ili9341_fill_rect(at, (uint16_t)y, n, (uint16_t)h, color);
+    else           ili9341_fill_rect((uint16_t)x, at, (uint16_t)w, n, color);
+}
 
-        if(g_cstate.b_y <= 0)
+// Redraws the center line dashes between rows y0 and y1 where they fall
+// in the painted lines, if a rectangle from x over w crossed the line
+static void paint_center_line(int16_t x, int16_t w, int16_t y0, int16_t y1,
+                              uint16_t line, uint16_t count, uint16_t source)
+{
+    const int16_t line_x = (int16_t)(g_screen_w / 2 - 1);
+    const int16_t dash_pitch = CENTER_DASH_H + CENTER_GAP_H;
+
+    if(!overlaps_center_line((uint16_t)x, (uint16_t)w)) return;
+
+    for(int16_t y = 0; y < g_screen_h; y = (int16_t)(y + dash_pitch))
+    {
+        int16_t top = (y > y0) ? y : y0;
+        int16_t end = (int16_t)(y + CENTER_DASH_H);
+        if(end > g_screen_h) end = g_screen_h;
+        if(end > y1) end = y1;
+        if(top < end)
         {
-            g_cstate.b_y = 0;
-            b_dy = -b_dy;
+            paint_rect(line_x, top, CENTER_LINE_W, (int16_t)(end - top), COLOR_WHITE, line, count, source);
         }
+    }
+}
+
+void pong_paint_field(uint16_t line, uint16_t count, uint32_t source)
+{
+    const uint16_t length = (uint16_t)(ili9341_scroll_horizontal() ? g_screen_w : g_screen_h);
+    const pong_state_t *old = &g_pstate;
+    const pong_state_t *cur = &g_cstate;
 
-        if(g_cstate.b_y + g_ball_h >= g_screen_h)
+    while(count)
+    {
+        uint16_t from = (uint16_t)(source % length);
+        uint16_t n = (uint16_t)(length - from);
+        if(n > count) n = count;
+
+        // Only the objects differ from the old field: clear where they
+        // were, draw where they are, then put back the center line over
+        // both balls and any hole the governor left in it
+        paint_rect(old->b_x, old->b_y, g_ball_w, g_ball_h, COLOR_BLACK, line, n, from);
+        paint_rect(old->l_x, old->l_y, g_pad_w, g_pad_h, COLOR_BLACK, line, n, from);
+        paint_rect(old->r_x, old->r_y, g_pad_w, g_pad_h, COLOR_BLACK, line, n, from);
+
+        paint_rect(cur->b_x, cur->b_y, g_ball_w, g_ball_h, COLOR_WHITE, line, n, from);
+        paint_rect(cur->l_x, cur->l_y, g_pad_w, g_pad_h, COLOR_WHITE, line, n, from);
+        paint_rect(cur->r_x, cur->r_y, g_pad_w, g_pad_h, COLOR_WHITE, line, n, from);
+
+        paint_center_line(old->b_x, g_ball_w, old->b_y, (int16_t)(old->b_y + g_ball_h), line, n, from);
+        paint_center_line(cur->b_x, g_ball_w, cur->b_y, (int16_t)(cur->b_y + g_ball_h), line, n, from);
+        if(g_line_dirty)
         {
-            g_cstate.b_y = (int16_t)(g_screen_h - g_ball_h);
-            b_dy = -b_dy;
+            paint_center_line((int16_t)(g_screen_w / 2 - 1), CENTER_LINE_W,
+                              (int16_t)g_line_dirty_y0, (int16_t)g_line_dirty_y1, line, n, from);
         }
 
-        // Ball bounce on left paddle
-        if(g_cstate.b_x <= g_cstate.l_x + g_pad_w &&
-            g_cstate.b_y + g_ball_h >= g_cstate.l_y &&
-            g_cstate.b_y <= g_cstate.l_y + g_pad_h)
-        {
-            // place ball outside of paddle and reverse direction
-            g_cstate.b_x = g_cstate.l_x + g_pad_w;
-            b_dx = -b_dx;
+        line = (uint16_t)(line + n);
+        count = (uint16_t)(count - n);
+        source += n;
+    }
+}
 
-            if(b_dx > 0 && b_dx < MAX_BALL_SPEED) b_dx++;
-            if(b_dx < 0 && b_dx > -MAX_BALL_SPEED) b_dx--;
-        }
-        // Ball bounce on right paddle
-        if(g_cstate.b_x + g_ball_w >= g_cstate.r_x &&
-            g_cstate.b_y + g_ball_h >= g_cstate.r_y &&
-            g_cstate.b_y <= g_cstate.r_y + g_pad_h)
-        {
-            // place ball outside of paddle and reverse direction
-            g_cstate.b_x = g_cstate.r_x - g_ball_w;
-            b_dx = -b_dx;
+void pong_new_round(void)
+{
+    const uint32_t tick_cycles = PERF_MS_TO_CYCLES(FRAME_MS);
+    bool done;
+
+    pong_reset(&g_cstate, &g_vel);
+    ai_init(&g_ai_config, g_screen_h);
+    journal_restart(); // the state jumps outside pong_step()
+
+    // The old field slides out as the new one is painted in behind it.
+    // Started at offset 0, each line comes round at its own position, so
+    // the paint only has to change what differs from g_pstate.
+    scroll_begin(0, 0);
+    do
+    {
+        g_deadline += tick_cycles;
+        done = scroll_push(WIPE_STEP, pong_paint_field);
+        power_frame_idle(g_deadline);
+    } while(!done);
+    scroll_end();
+
+    g_pstate = g_cstate;
+    g_line_dirty = false;
+}
 
-            if(b_dx > 0 && b_dx < MAX_BALL_SPEED) b_dx++;
-            if(b_dx < 0 && b_dx > -MAX_BALL_SPEED) b_dx--;
-        }
+void pong_attract(void)
+{
+    dwt_delay_ms(100);
 
-        // Reset if ball goes off screen
-        if(g_cstate.b_x < 0 || g_cstate.b_x + g_ball_w > g_screen_w)
-        {
-            g_cstate.b_x = (g_screen_w / 2) - (g_ball_w / 2);
-            g_cstate.b_y = (g_screen_h / 2) - (g_ball_h / 2);
-            b_dx = (b_dx > 0) ? -3 : 3;
-            b_dy = 2;
-        }
+    g_deadline = power_now();
+    for(;;)
+    {
+        pong_run(ATTRACT_ROUND_TICKS);
+        pong_new_round();
+    }
+}
 
-        // Simple paddle follow ball
-        if(g_cstate.l_y + g_pad_h / 2 < g_cstate.b_y) g_cstate.l_y += PADDLE_SPEED;
-        else if(g_cstate.l_y + g_pad_h / 2 > g_cstate.b_y) g_cstate.l_y -= PADDLE_SPEED;
+static int16_t clamp_move(int16_t dy)
+{
+    if(dy > PADDLE_SPEED) return PADDLE_SPEED;
+    if(dy < -PADDLE_SPEED) return -PADDLE_SPEED;
+    return dy;
+}
 
-        if(g_cstate.r_y + g_pad_h / 2 < g_cstate.b_y) g_cstate.r_y += PADDLE_SPEED;
-        else if(g_cstate.r_y + g_pad_h / 2 > g_cstate.b_y) g_cstate.r_y -= PADDLE_SPEED;
+void pong_step(pong_state_t *state, pong_vel_t *vel, const pong_input_t *input)
+{
+    // --- Move ball ---
+    state->b_x += vel->b_dx;
+    state->b_y += vel->b_dy;
 
-        // Clamp paddles
-        if(g_cstate.l_y < 0) g_cstate.l_y = 0;
-        if(g_cstate.l_y + g_pad_h > g_screen_h) g_cstate.l_y = g_screen_h - g_pad_h;
-        if(g_cstate.r_y < 0) g_cstate.r_y = 0;
-        if(g_cstate.r_y + g_pad_h > g_screen_h) g_cstate.r_y = g_screen_h - g_pad_h;
+    if(state->b_y <= 0)
+    {
+        state->b_y = 0;
+        vel->b_dy = -vel->b_dy;
+    }
 
-        // Draw
-        draw_left_paddle();
-        draw_right_paddle();
-        draw_ball();
+    if(state->b_y + g_ball_h >= g_screen_h)
+    {
+        state->b_y = (int16_t)(g_screen_h - g_ball_h);
+        vel->b_dy = -vel->b_dy;
+    }
+
+    // Ball bounce on left paddle
+    if(state->b_x <= state->l_x + g_pad_w &&
+        state->b_y + g_ball_h >= state->l_y &&
+        state->b_y <= state->l_y + g_pad_h)
+    {
+        // place ball outside of paddle and reverse direction
+        state->b_x = state->l_x + g_pad_w;
+        vel->b_dx = -vel->b_dx;
 
-        dwt_delay_ms(16);
+        if(vel->b_dx > 0 && vel->b_dx < MAX_BALL_SPEED) vel->b_dx++;
+        if(vel->b_dx < 0 && vel->b_dx > -MAX_BALL_SPEED) vel->b_dx--;
     }
+    // Ball bounce on right paddle
+    if(state->b_x + g_ball_w >= state->r_x &&
+        state->b_y + g_ball_h >= state->r_y &&
+        state->b_y <= state->r_y + g_pad_h)
+    {
+        // place ball outside of paddle and reverse direction
+        state->b_x = state->r_x - g_ball_w;
+        vel->b_dx = -vel->b_dx;
+
+        if(vel->b_dx > 0 && vel->b_dx < MAX_BALL_SPEED) vel->b_dx++;
+        if(vel->b_dx < 0 && vel->b_dx > -MAX_BALL_SPEED) vel->b_dx--;
+    }
+
+    // Reset if ball goes off screen
+    if(state->b_x < 0 || state->b_x + g_ball_w > g_screen_w)
+    {
+        state->b_x = (g_screen_w / 2) - (g_ball_w / 2);
+        state->b_y = (g_screen_h / 2) - (g_ball_h / 2);
+        vel->b_dx = (vel->b_dx > 0) ? -3 : 3;
+        vel->b_dy = 2;
+    }
+
+    // --- Move paddles ---
+    state->l_y += clamp_move(input->l_dy);
+    state->r_y += clamp_move(input->r_dy);
+
+    // Clamp paddles
+    if(state->l_y < 0) state->l_y = 0;
+    if(state->l_y + g_pad_h > g_screen_h) state->l_y = g_screen_h - g_pad_h;
+    if(state->r_y < 0) state->r_y = 0;
+    if(state->r_y + g_pad_h > g_screen_h) state->r_y = g_screen_h - g_pad_h;
+}
+
+void pong_follow(const pong_state_t *state, pong_input_t *input)
+{
+    input->l_dy = 0;
+    if(state->l_y + g_pad_h / 2 < state->b_y) input->l_dy = PADDLE_SPEED;
+    else if(state->l_y + g_pad_h / 2 > state->b_y) input->l_dy = -PADDLE_SPEED;
+
+    input->r_dy = 0;
+    if(state->r_y + g_pad_h / 2 < state->b_y) input->r_dy = PADDLE_SPEED;
+    else if(state->r_y + g_pad_h / 2 > state->b_y) input->r_dy = -PADDLE_SPEED;
+}
+
+void pong_run(uint32_t ticks)
+{
+    const uint32_t tick_cycles = PERF_MS_TO_CYCLES(FRAME_MS);
+
+    for(uint32_t n = 0; ticks == 0 || n < ticks; ++n)
+    {
+        pong_input_t input;
+
+        g_deadline += tick_cycles;
+        arena_frame_reset();
+
+        ai_update(&g_cstate, &g_vel, &input);
+        pong_step(&g_cstate, &g_vel, &input);
+        journal_record(&g_cstate, &g_vel);
+
+        // Draw if the governor has room for this tick
+        if(governor_tick())
+        {
+            uint32_t start = power_now();
+
+            pong_draw_frame(&g_pstate, &g_cstate);
+            g_pstate = g_cstate; // now on screen
+
+            governor_frame_done(power_now() - start);
+        }
+
+        // Sleep out the rest of the tick. Late ticks run back to back to
+        // catch up; if the loop falls too far behind, start again from now.
+        power_frame_idle(g_deadline);
+        if(power_now() - g_deadline > tick_cycles * GOVERNOR_MAX_DIVIDER &&
+           perf_reached(power_now(), g_deadline))
+        {
+            g_deadline = power_now();
+        }
+    }
+}
+
+void pong_play(void)
+{
+    dwt_delay_ms(100);
+
+    g_deadline = power_now();
+    pong_run(0);
 }
@@ -9,6 +9,14 @@
 #define BALL_SPEED      5
 #define MAX_BALL_SPEED  10
 #define PADDLE_SPEED    3
+#define FRAME_MS        16  // game tick period
+
+#define CENTER_DASH_H   8
+#define CENTER_GAP_H    4
+#define CENTER_LINE_W   2
+
+#define WIPE_STEP           8       // lines per tick in a new-round transition
+#define ATTRACT_ROUND_TICKS 600
 
 
 typedef struct
@@ -26,9 +34,108 @@ typedef struct
     int16_t b_y;
 } pong_state_t;
 
+typedef struct
+{
+    // ball velocity in pixels per tick
+    int16_t b_dx;
+    int16_t b_dy;
+} pong_vel_t;
+
+typedef struct
+{
+    // paddle moves for this tick in pixels, clamped to +/-PADDLE_SPEED
+    int16_t l_dy;
+    int16_t r_dy;
+} pong_input_t;
+
 
 void pong_init(void);
 
 void pong_play(void);
 
+/**
+ * @brief Runs the game loop: step, record, draw when the governor allows,
+ *        sleep until the next tick.
+ *
+ * @param ticks Number of ticks to run, or 0 to run forever.
+ */
+void pong_run(uint32_t ticks);
+
+/**
+ * @brief Puts the paddles and ball at their serve positions.
+ *
+ * Uses the screen size captured by pong_init().
+ *
+ * @param state State to reset.
+ * @param vel   Ball velocity to reset.
+ */
+void pong_reset(pong_state_t *state, pong_vel_t *vel);
+
+/**
+ * @brief Advances the game by one tick.
+ *
+ * Moves the ball, resolves wall/paddle bounces and applies the paddle
+ * moves. Has no side effects beyond the state and velocity, so the same
+ * inputs always produce the same outputs.
+ *
+ * @param state State to advance in place.
+ * @param vel   Ball velocity to advance in place.
+ * @param input Paddle moves for this tick.
+ */
+void pong_step(pong_state_t *state, pong_vel_t *vel, const pong_input_t *input);
+
+/**
+ * @brief Computes the paddle moves of the simple chaser: each paddle
+ *        steps toward the ball's current y every tick.
+ *
+ * @param state Current state.
+ * @param input Receives the paddle moves.
+ */
+void pong_follow(const pong_state_t *state, pong_input_t *input);
+
+/**
+ * @brief Clears the screen and draws the whole playfield for a state.
+ *
+ * @param state State to draw.
+ */
+void pong_draw_field(const pong_state_t *state);
+
+/**
+ * @brief Draws the changes between two consecutive states.
+ *
+ * Erases the objects at their previous positions and draws them at
+ * their current ones.
+ *
+ * @param prev State shown on screen.
+ * @param cur  State to show.
+ */
+void pong_draw_frame(const pong_state_t *prev, const pong_state_t *cur);
+
+/**
+ * @brief Brings whole lines of the screen, along the scroll axis, from the
+ *        field last drawn to the field as it stands; a scroll_paint_t for
+ *        scroll.h.
+ *
+ * Only the old and new ball and paddles are painted, with the center
+ * line put back under them, so the lines must still hold the last drawn
+ * field at their own positions, as in a push started at offset 0.
+ *
+ * @param line   First drawing line.
+ * @param count  Number of lines.
+ * @param source First field line, taken modulo the field length.
+ */
+void pong_paint_field(uint16_t line, uint16_t count, uint32_t source);
+
+/**
+ * @brief Starts a new round: resets the ball and paddles and slides the
+ *        fresh field in with the hardware scroll, WIPE_STEP lines a tick.
+ */
+void pong_new_round(void);
+
+/**
+ * @brief Plays CPU against CPU forever, with a new round every
+ *        ATTRACT_ROUND_TICKS ticks.
+ */
+void pong_attract(void);
+
 #endif
@@ -0,0 +1,154 @@
+#include "power.h"
+
+#include <string.h>
+
+#include "perf.h"
+
+#ifndef HOST_BUILD
+// TIM2 runs free at the core clock (APB1 x1 out of reset) and is the frame
+// timebase. Unlike the DWT cycle counter it keeps counting while the core
+// sleeps, and its compare channel provides the wake-up interrupt.
+#define POWER_RCC_APB1ENR   (*(volatile uint32_t *)0x40023840UL)
+#define POWER_TIM2_BASE     0x40000000UL
+#define POWER_TIM2_CR1      (*(volatile uint32_t *)(POWER_TIM2_BASE + 0x00UL))
+#define POWER_TIM2_DIER     (*(volatile uint32_t *)(POWER_TIM2_BASE + 0x0CUL))
+#define POWER_TIM2_SR       (*(volatile uint32_t *)(POWER_TIM2_BASE + 0x10UL))
+#define POWER_TIM2_EGR      (*(volatile uint32_t *)(POWER_TIM2_BASE + 0x14UL))
+#define POWER_TIM2_CNT      (*(volatile uint32_t *)(POWER_TIM2_BASE + 0x24UL))
+#define POWER_TIM2_PSC      (*(volatile uint32_t *)(POWER_TIM2_BASE + 0x28UL))
+#define POWER_TIM2_ARR      (*(volatile uint32_t *)(POWER_TIM2_BASE + 0x2CUL))
+#define POWER_TIM2_CCR1     (*(volatile uint32_t *)(POWER_TIM2_BASE + 0x34UL))
+#define POWER_NVIC_ISER0    (*(volatile uint32_t *)0xE000E100UL)
+
+#define POWER_APB1ENR_TIM2  (1U << 0)
+#define POWER_TIM_CR1_CEN   (1U << 0)
+#define POWER_TIM_DIER_CC1  (1U << 1)
+#define POWER_TIM_SR_CC1    (1U << 1)
+#define POWER_TIM_EGR_UG    (1U << 0)
+#define POWER_TIM2_IRQ      28U
+#endif
+
+// Below this many cycles it is cheaper to spin than to sleep
+#define MIN_SLEEP_CYCLES    128U
+
+static power_stats_t g_stats;
+static uint32_t g_frame_start;
+static uint32_t g_frame_sleep;
+
+
+#ifndef HOST_BUILD
+void TIM2_Handler(void)
+{
+    // One-shot: the sleeper re-arms the compare for every wait
+    POWER_TIM2_DIER &= ~POWER_TIM_DIER_CC1;
+    POWER_TIM2_SR = ~POWER_TIM_SR_CC1;
+}
+#endif
+
+static void sleep_until(uint32_t deadline)
+{
+#ifdef HOST_BUILD
+    sim_advance(deadline - power_now());
+#else
+    __asm volatile ("cpsid i" ::: "memory");
+
+    POWER_TIM2_CCR1 = deadline;
+    POWER_TIM2_SR = ~POWER_TIM_SR_CC1;
+    POWER_TIM2_DIER |= POWER_TIM_DIER_CC1;
+
+    // With interrupts masked the wake-up can't be lost between the check and
+    // the WFI: a pending interrupt still ends the WFI, and is taken on cpsie.
+    if(!perf_reached(power_now(), deadline))
+    {
+        __asm volatile ("dsb\n\twfi" ::: "memory");
+    }
+
+    __asm volatile ("cpsie i" ::: "memory");
+#endif
+}
+
+void power_init(void)
+{
+#ifndef HOST_BUILD
+    POWER_RCC_APB1ENR |= POWER_APB1ENR_TIM2;
+    (void)POWER_RCC_APB1ENR;
+
+    POWER_TIM2_CR1 = 0;
+    POWER_TIM2_PSC = 0;
+    POWER_TIM2_ARR = 0xFFFFFFFFUL;
+    POWER_TIM2_EGR = POWER_TIM_EGR_UG;
+    POWER_TIM2_SR = 0;
+    POWER_TIM2_CR1 = POWER_TIM_CR1_CEN;
+
+    POWER_NVIC_ISER0 = 1UL << POWER_TIM2_IRQ;
+#endif
+
+    memset(&g_stats, 0, sizeof(g_stats));
+    g_frame_start = power_now();
+    g_frame_sleep = 0;
+}
+
+uint32_t power_now(void)
+{
+#ifdef HOST_BUILD
+    return perf_cycles();
+#else
+    return POWER_TIM2_CNT;
+#endif
+}
+
+void power_sleep_until(uint32_t deadline)
+{
+    uint32_t now = power_now();
+
+    while(!perf_reached(now, deadline))
+    {
+        if(deadline - now < MIN_SLEEP_CYCLES)
+        {
+            while(!perf_reached(power_now(), deadline));
+            break;
+        }
+
+        sleep_until(deadline);
+
+        uint32_t woke = power_now();
+        g_frame_sleep += woke - now;
+        now = woke;
+    }
+}
+
+void power_frame_idle(uint32_t deadline)
+{
+    uint32_t now = power_now();
+    uint32_t overrun = perf_reached(now, deadline) ? now - deadline : 0;
+
+    power_sleep_until(deadline);
+
+    now = power_now();
+    uint32_t frame = now - g_frame_start;
+
+    g_stats.frame_cycles = frame;
+    g_stats.sleep_cycles = g_frame_sleep;
+    g_stats.active_cycles = frame - g_frame_sleep;
+    g_stats.overrun_cycles = overrun;
+
+    g_stats.frames++;
+    if(overrun) g_stats.overruns++;
+    g_stats.total_active += g_stats.active_cycles;
+    g_stats.total_sleep += g_stats.sleep_cycles;
+
+    g_frame_start = now;
+    g_frame_sleep = 0;
+}
+
+const power_stats_t *power_get_stats(void)
+{
+    return &g_stats;
+}
+
+uint16_t power_duty_permille(void)
+{
+    uint64_t total = g_stats.total_active + g_stats.total_sleep;
+    if(total == 0) return 1000;
+    return (uint16_t)((g_stats.total_active * 1000U) / total);
+}
@@ -0,0 +1,68 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <stdint.h>
+
+// Idle-time sleep and per-frame energy accounting.
+//
+// The frame loop sleeps the core with WFI until the next frame deadline,
+// woken by a TIM2 compare interrupt. Sleep mode keeps the bus clocks
+// running, so peripherals carry on while the core is stopped.
+// Each frame is split into active and sleeping cycles so the saving can
+// be read back at runtime.
+
+typedef struct
+{
+    // Last completed frame
+    uint32_t frame_cycles;
+    uint32_t active_cycles;
+    uint32_t sleep_cycles;
+    uint32_t overrun_cycles;    // time past the deadline when the work ended
+
+    // Since power_init()
+    uint32_t frames;
+    uint32_t overruns;
+    uint64_t total_active;
+    uint64_t total_sleep;
+} power_stats_t;
+
+/**
+ * @brief Sets up the wake-up timer and clears the counters.
+ */
+void power_init(void);
+
+/**
+ * @brief Returns the frame timebase, in core clock cycles.
+ *
+ * Keeps counting while the core sleeps.
+ */
+uint32_t power_now(void);
+
+/**
+ * @brief Sleeps until the timebase reaches a deadline.
+ *
+ * Returns straight away if the deadline has already passed. Time spent
+ * here is booked as sleep in the current frame.
+ *
+ * @param deadline power_now() value to wake at.
+ */
+void power_sleep_until(uint32_t deadline);
+
+/**
+ * @brief Ends the frame's work, sleeps out the rest of it and books it.
+ *
+ * @param deadline power_now() value the frame ends at.
+ */
+void power_frame_idle(uint32_t deadline);
+
+/**
+ * @brief Returns the accounting counters.
+ */
+const power_stats_t *power_get_stats(void);
+
+/**
+ * @brief Returns the share of time the core was awake, in permille.
+ */
+uint16_t power_duty_permille(void);
+
+#endif
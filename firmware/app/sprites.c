@@ -0,0 +1,35 @@
+#include "sprites.h"
+
+#include "ili9341.h"
+#include "pong.h"
+
+#define SPRITE_MAX_PIXELS   (PADDLE_W * PADDLE_H)
+
+_Static_assert(BALL_SIZE * BALL_SIZE <= SPRITE_MAX_PIXELS, "pixel blocks too small for the ball");
+_Static_assert(COLOR_BLACK == 0, "the black block relies on zero-initialised storage");
+
+static uint8_t g_white[ILI9341_SPRITE_BYTES(PADDLE_W, PADDLE_H)];
+static const uint8_t g_black[ILI9341_SPRITE_BYTES(PADDLE_W, PADDLE_H)];
+
+// [shape][on]
+static ili9341_sprite_t g_sprites[SPRITE_SHAPES][2] = {
+    [SPRITE_BALL] = {
+        ILI9341_SPRITE(BALL_SIZE, BALL_SIZE, g_black),
+        ILI9341_SPRITE(BALL_SIZE, BALL_SIZE, g_white)
+    },
+    [SPRITE_PADDLE] = {
+        ILI9341_SPRITE(PADDLE_W, PADDLE_H, g_black),
+        ILI9341_SPRITE(PADDLE_W, PADDLE_H, g_white)
+    },
+};
+
+
+void sprites_init(void)
+{
+    ili9341_fill_pixels(g_white, COLOR_WHITE, SPRITE_MAX_PIXELS);
+}
+
+void sprites_draw(sprite_shape_t shape, int16_t x, int16_t y, bool on)
+{
+    ili9341_draw_sprite(&g_sprites[shape][on ? 1 : 0], (uint16_t)x, (uint16_t)y);
+}
@@ -0,0 +1,38 @@
+#ifndef SPRITES_H
+#define SPRITES_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// The game's fixed-size shapes as prepared sprite packets (ili9341.h).
+//
+// Balls and paddles are always BALL_SIZE x BALL_SIZE and PADDLE_W x
+// PADDLE_H, drawn white and erased black. Each shape and color has its
+// command packet built at compile time, and all of them share two pixel
+// blocks sized for the largest shape, so a draw costs eight byte stores
+// and one chip select instead of three command transfers and a color
+// buffer fill.
+
+typedef enum
+{
+    SPRITE_BALL = 0,
+    SPRITE_PADDLE,
+    SPRITE_SHAPES
+} sprite_shape_t;
+
+/**
+ * @brief Expands the white pixel block; safe to call again.
+ */
+void sprites_init(void);
+
+/**
+ * @brief Draws a shape white, or erases it to black.
+ *
+ * @param shape Which shape.
+ * @param x     X-coordinate of the top-left corner.
+ * @param y     Y-coordinate of the top-left corner.
+ * @param on    true to draw, false to erase.
+ */
+void sprites_draw(sprite_shape_t shape, int16_t x, int16_t y, bool on);
+
+#endif
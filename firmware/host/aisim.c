@@ -0,0 +1,196 @@
+// CPU paddle AI check and comparison.
+//
+// First checks ai_predict() against pong_step(): random ball states are
+// stepped with both paddles held on the ball, so the ball bounces on the
+// first tick it reaches a paddle column, and the tick and y of that
+// bounce must match the prediction exactly.
+//
+// Then plays the same number of ticks with the simple chaser and with
+// the AI, and reports missed balls, paddle travel and host time per tick
+// (controller and pong_step()) for each.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ai.h"
+#include "f446re.h"
+#include "ili9341.h"
+#include "pong.h"
+
+typedef struct
+{
+    uint32_t shots;         // balls that reached a paddle column
+    uint32_t misses;        // of those, balls that were served again
+    uint32_t travel;        // paddle pixels moved
+    double tick_ns;
+} play_result_t;
+
+static uint16_t g_width;
+static uint16_t g_height;
+static uint32_t g_rng = 2463534242UL;
+
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: aisim [-n ticks] [-s shots] [-r reaction] [-e error]\n"
+            "  -n ticks     ticks to play per controller (default 100000)\n"
+            "  -s shots     random predictions to check (default 100000)\n"
+            "  -r reaction  AI reaction delay in ticks (default %u)\n"
+            "  -e error     AI aim error in pixels (default %u)\n",
+            AI_REACTION_TICKS, AI_ERROR_PX);
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static int32_t rand_range(int32_t lo, int32_t hi)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return lo + (int32_t)(g_rng % (uint32_t)(hi - lo + 1));
+}
+
+static void hold_paddles(pong_state_t *state)
+{
+    state->l_y = (int16_t)(state->b_y - PADDLE_H / 2);
+    state->r_y = state->l_y;
+}
+
+static uint32_t check_predictions(uint32_t shots)
+{
+    uint32_t wrong = 0;
+
+    for(uint32_t n = 0; n < shots; ++n)
+    {
+        pong_state_t state;
+        pong_vel_t vel;
+        pong_input_t still = { 0, 0 };
+
+        pong_reset(&state, &vel);
+        state.b_x = (int16_t)rand_range(state.l_x + PADDLE_W + 1, state.r_x - BALL_SIZE - 1);
+        state.b_y = (int16_t)rand_range(0, g_height - BALL_SIZE);
+        vel.b_dx = (int16_t)rand_range(1, MAX_BALL_SPEED);
+        vel.b_dy = (int16_t)rand_range(-MAX_BALL_SPEED, MAX_BALL_SPEED);
+        if(rand_range(0, 1)) vel.b_dx = (int16_t)-vel.b_dx;
+
+        bool left = vel.b_dx < 0;
+        uint16_t want_ticks;
+        int16_t want_y = ai_predict(&state, &vel, left, &want_ticks);
+
+        // Step until the ball turns around on a paddle
+        uint16_t t = 0;
+        int16_t dx = vel.b_dx;
+        while(vel.b_dx == dx && t < 1000)
+        {
+            hold_paddles(&state);
+            pong_step(&state, &vel, &still);
+            ++t;
+        }
+
+        if(t != want_ticks || state.b_y != want_y)
+        {
+            if(wrong < 10)
+            {
+                printf("shot %u: predicted y %d at tick %u, pong_step gives y %d at tick %u\n",
+                       n, want_y, want_ticks, state.b_y, t);
+            }
+            ++wrong;
+        }
+    }
+
+    return wrong;
+}
+
+static void play(bool use_ai, const ai_config_t *config, uint32_t ticks, play_result_t *r)
+{
+    pong_state_t state;
+    pong_vel_t vel;
+
+    memset(r, 0, sizeof(*r));
+    pong_reset(&state, &vel);
+    ai_init(config, (int16_t)g_height);
+
+    double t0 = now_ns();
+
+    for(uint32_t n = 0; n < ticks; ++n)
+    {
+        pong_input_t input;
+        int16_t dx = vel.b_dx;
+        int16_t l_y = state.l_y;
+        int16_t r_y = state.r_y;
+
+        if(use_ai) ai_update(&state, &vel, &input);
+        else pong_follow(&state, &input);
+
+        pong_step(&state, &vel, &input);
+
+        r->travel += (uint32_t)abs(state.l_y - l_y) + (uint32_t)abs(state.r_y - r_y);
+
+        // A serve always comes back at 3 px/tick; a paddle bounce never does
+        if(vel.b_dx != dx)
+        {
+            ++r->shots;
+            if(vel.b_dx == 3 || vel.b_dx == -3) ++r->misses;
+        }
+    }
+
+    r->tick_ns = (now_ns() - t0) / ticks;
+}
+
+static void print_play(const char *name, const play_result_t *r)
+{
+    printf("%-10s %6u shots %6u missed (%5.2f%%) %8u px travel %6.1f ns/tick\n",
+           name, r->shots, r->misses, r->shots ? 100.0 * r->misses / r->shots : 0.0,
+           r->travel, r->tick_ns);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t ticks = 100000;
+    uint32_t shots = 100000;
+    ai_config_t config = {
+        .reaction_ticks = AI_REACTION_TICKS,
+        .error_px = AI_ERROR_PX,
+        .seed = 1
+    };
+
+    for(int i = 1; i < argc; ++i)
+    {
+        if(i + 1 >= argc) { usage(); return 1; }
+
+        if(!strcmp(argv[i], "-n"))      ticks = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if(!strcmp(argv[i], "-s")) shots = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if(!strcmp(argv[i], "-r")) config.reaction_ticks = (uint8_t)strtoul(argv[++i], NULL, 0);
+        else if(!strcmp(argv[i], "-e")) config.error_px = (uint8_t)strtoul(argv[++i], NULL, 0);
+        else { usage(); return 1; }
+    }
+    if(ticks == 0) { usage(); return 1; }
+
+    sim_reset();
+    pong_init();
+    ili9341_get_screen_size(&g_width, &g_height);
+
+    uint32_t wrong = check_predictions(shots);
+
+    play_result_t chase, ai;
+    play(false, &config, ticks, &chase);
+    play(true, &config, ticks, &ai);
+
+    printf("reaction   %u ticks, aim error +/-%u px\n", config.reaction_ticks, config.error_px);
+    print_play("chaser", &chase);
+    print_play("ai", &ai);
+    printf("replans    %u in %u ticks\n", ai_get_stats()->predictions, ai_get_stats()->ticks);
+    printf("predict    %s (%u of %u shots wrong)\n", wrong ? "FAIL" : "ok", wrong, shots);
+
+    return wrong ? 2 : 0;
+}
@@ -0,0 +1,122 @@
+// Multi-ball scaling benchmark.
+//
+// For 1 to 256 balls, runs the stress mode on the simulated panel and
+// reports the tick cost (host time, grid candidates) and the render cost
+// of the batched span path against drawing every ball on its own. The
+// render cost is the simulated clock across balls_draw(): bus and driver
+// calls for both paths, plus, for the spans, the modelled CPU time of
+// composing their pixels in RAM (SIM_CYCLES_PER_COMPOSE_*), shown on its
+// own as well.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "balls.h"
+#include "f446re.h"
+#include "ili9341.h"
+#include "pong.h"
+
+#define WARMUP_TICKS 60
+#define BENCH_TICKS  600
+
+typedef struct
+{
+    double tick_ns;
+    double pair_tests;
+    double collisions;
+    double windows;
+    double pixels;
+    double compose_cycles;
+    double draw_cycles;
+} bench_result_t;
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void run(uint16_t count, bool batched, bench_result_t *r)
+{
+    memset(r, 0, sizeof(*r));
+
+    balls_init(count, 12345U);
+    for(uint32_t t = 0; t < WARMUP_TICKS; ++t)
+    {
+        balls_step();
+        balls_draw(batched);
+    }
+
+    const balls_stats_t *bs = balls_get_stats();
+    double step_ns = 0;
+
+    for(uint32_t t = 0; t < BENCH_TICKS; ++t)
+    {
+        double t0 = now_ns();
+        balls_step();
+        step_ns += now_ns() - t0;
+
+        r->pair_tests += bs->pair_tests;
+        r->collisions += bs->collisions;
+
+        uint64_t c0 = sim_cycles();
+        balls_draw(batched);
+        r->draw_cycles += (double)(sim_cycles() - c0);
+        r->windows += bs->windows;
+        r->pixels += bs->pixels;
+        r->compose_cycles += bs->compose_cycles;
+    }
+
+    r->tick_ns = step_ns / BENCH_TICKS;
+    r->pair_tests /= BENCH_TICKS;
+    r->collisions /= BENCH_TICKS;
+    r->windows /= BENCH_TICKS;
+    r->pixels /= BENCH_TICKS;
+    r->compose_cycles /= BENCH_TICKS;
+    r->draw_cycles /= BENCH_TICKS;
+}
+
+int main(void)
+{
+    sim_reset();
+    pong_init();
+
+    printf("%5s | %9s %8s %7s | %32s | %24s\n",
+           "", "tick", "pairs", "bounces", "batched spans", "per-ball windows");
+    printf("%5s | %9s %8s %7s | %7s %7s %7s %8s | %7s %7s %8s | %s\n",
+           "balls", "ns (host)", "tested", "", "windows", "pixels", "compose", "cycles",
+           "windows", "pixels", "cycles", "faster");
+
+    // Smallest count from which batching stays faster
+    uint32_t batch_from = BALLS_MAX + 1U;
+
+    for(uint16_t n = 1; n <= BALLS_MAX; n = (uint16_t)(n * 2U))
+    {
+        bench_result_t b, p;
+        run(n, true, &b);
+        run(n, false, &p);
+
+        if(b.draw_cycles >= p.draw_cycles) batch_from = BALLS_MAX + 1U;
+        else if(batch_from > BALLS_MAX) batch_from = n;
+
+        printf("%5u | %9.0f %8.1f %7.2f | %7.1f %7.0f %7.0f %8.0f | %7.1f %7.0f %8.0f | %s\n",
+               n, b.tick_ns, b.pair_tests, b.collisions,
+               b.windows, b.pixels, b.compose_cycles, b.draw_cycles,
+               p.windows, p.pixels, p.draw_cycles,
+               b.draw_cycles < p.draw_cycles ? "batched" : "per-ball");
+    }
+
+    printf("\ndraw cycles are simulated bus and driver-call time at %u cycles per SPI "
+           "byte, plus the modelled compose time; a %u ms frame has %lu cycles\n",
+           SIM_CYCLES_PER_SPI_BYTE, FRAME_MS, (unsigned long)(SIM_CPU_HZ / 1000UL * FRAME_MS));
+
+    if(batch_from > BALLS_MAX) printf("threshold  batching never wins");
+    else                       printf("threshold  batching wins from %u balls", batch_from);
+    printf(", BALLS_BATCH_MIN is %u\n", (unsigned)BALLS_BATCH_MIN);
+    return 0;
+}
@@ -0,0 +1,46 @@
+// Display primitive benchmark on the host.
+//
+// Runs the same suite as the benchmark firmware (make bench, app/bench.h)
+// against the simulated SPI timing and prints the same report, so the
+// numbers can be put next to the ones the board sends.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "f446re.h"
+#include "pong.h"
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: dispbench [-b cycles]\n"
+            "  -b cycles  core cycles per SPI byte (default %u)\n",
+            SIM_CYCLES_PER_SPI_BYTE);
+}
+
+static void print_line(const char *line)
+{
+    puts(line);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t byte_cycles = SIM_CYCLES_PER_SPI_BYTE;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        if(i + 1 >= argc) { usage(); return 1; }
+
+        if(!strcmp(argv[i], "-b")) byte_cycles = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else { usage(); return 1; }
+    }
+
+    sim_reset();
+    pong_init();
+    sim_set_spi_cycles_per_byte(byte_cycles);
+
+    bench_run(byte_cycles, print_line);
+    return 0;
+}
@@ -0,0 +1,222 @@
+// Two-board linked play on the host.
+//
+// Forks two instances of the game, each with its own simulated panel,
+// connected through a socketpair (or a pseudo-terminal with -t) in place
+// of the USART cable. Link latency is modelled by holding each side's
+// bytes back for a number of simulated milliseconds, and each tick also
+// sleeps a random amount of real time so the two sides drift against
+// each other. At the end both sides wait for every input, and the final
+// states must agree.
+
+#define _XOPEN_SOURCE 600
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "f446re.h"
+#include "link.h"
+#include "netplay.h"
+#include "perf.h"
+#include "pong.h"
+#include "power.h"
+
+typedef struct
+{
+    bool ok;
+    uint16_t hash;
+    netplay_stats_t net;
+    link_stats_t link;
+} side_result_t;
+
+typedef struct
+{
+    uint32_t ticks;
+    uint32_t latency_ms;
+    uint32_t jitter_us;
+} options_t;
+
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: linkplay [-n ticks] [-l latency_ms] [-j jitter_us] [-t]\n"
+            "  -n ticks       ticks to play (default 3000)\n"
+            "  -l latency_ms  one-way link latency in simulated ms (default 40)\n"
+            "  -j jitter_us   max random real-time sleep per tick (default 500)\n"
+            "  -t             connect through a pseudo-terminal instead of a socketpair\n");
+}
+
+static void run_side(int fd, int out, int hold, uint16_t nonce, const options_t *opt)
+{
+    side_result_t r;
+    uint32_t rng = nonce * 2654435761UL;
+
+    memset(&r, 0, sizeof(r));
+
+    sim_reset();
+    pong_init();
+
+    sim_uart_attach(fd);
+    sim_uart_set_latency((uint64_t)PERF_MS_TO_CYCLES(opt->latency_ms));
+
+    r.ok = netplay_init(nonce);
+
+    uint32_t deadline = power_now();
+    for(uint32_t n = 0; r.ok && n < opt->ticks; ++n)
+    {
+        r.ok = netplay_tick();
+
+        if(opt->jitter_us)
+        {
+            rng = rng * 1664525UL + 1013904223UL;
+            struct timespec ts = { 0, (long)((rng >> 8) % opt->jitter_us) * 1000L };
+            nanosleep(&ts, NULL);
+        }
+
+        deadline += PERF_MS_TO_CYCLES(FRAME_MS);
+        power_sleep_until(deadline);
+    }
+
+    if(r.ok) r.ok = netplay_sync();
+
+    r.hash = netplay_hash();
+    r.net = *netplay_get_stats();
+    r.link = *link_get_stats();
+
+    if(write(out, &r, sizeof(r)) != (ssize_t)sizeof(r)) _exit(3);
+
+    // Keep the link open until the other side is done too; a pty drops
+    // whatever is unread when one end closes
+    char c;
+    while(read(hold, &c, 1) > 0);
+    _exit(0);
+}
+
+static bool open_pty(int fds[2])
+{
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if(master < 0 || grantpt(master) || unlockpt(master)) return false;
+
+    int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    if(slave < 0) return false;
+
+    // Raw 8-bit bytes, no echo or line editing
+    struct termios t;
+    tcgetattr(slave, &t);
+    t.c_iflag &= ~(tcflag_t)(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON);
+    t.c_oflag &= ~(tcflag_t)OPOST;
+    t.c_lflag &= ~(tcflag_t)(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+    t.c_cflag &= ~(tcflag_t)(CSIZE | PARENB);
+    t.c_cflag |= CS8;
+    t.c_cc[VMIN] = 0;
+    t.c_cc[VTIME] = 0;
+    tcsetattr(slave, TCSANOW, &t);
+
+    fds[0] = master;
+    fds[1] = slave;
+    return true;
+}
+
+static void print_side(const char *name, const side_result_t *r, uint32_t ticks)
+{
+    const netplay_stats_t *s = &r->net;
+
+    printf("%-6s %s, %s paddle, %u ticks, hash %04x\n", name, r->ok ? "ok" : "LINK LOST",
+           s->left ? "left" : "right", s->tick, r->hash);
+    printf("       rollbacks %u (%.1f%% of ticks), depth avg %.2f max %u, %u ticks resimulated\n",
+           s->rollbacks, ticks ? 100.0 * s->rollbacks / ticks : 0.0,
+           s->rollbacks ? (double)s->resim_ticks / s->rollbacks : 0.0, s->depth_max, s->resim_ticks);
+    printf("       depth     ");
+    for(uint32_t d = 1; d <= NETPLAY_MAX_ROLLBACK; ++d) printf(" %u:%u", d, s->depth_hist[d]);
+    printf("\n");
+    printf("       resim     %.2f us avg, %.2f us max per rollback (host clock)\n",
+           s->rollbacks ? (double)s->resim_cycles / s->rollbacks / 1000.0 : 0.0,
+           s->resim_cycles_max / 1000.0);
+    printf("       stalls    %u ticks, %.1f ms waiting\n",
+           s->stalls, (double)s->stall_cycles * 1000.0 / PERF_CPU_HZ);
+    printf("       link      %.1f bytes/tick out, %u frames in, %u bad, %u drops\n",
+           ticks ? (double)r->link.tx_bytes / ticks : 0.0, r->link.rx_frames,
+           r->link.bad_frames, r->link.tx_drops);
+    printf("       checks    %u compared, %u desyncs\n", s->checks, s->desyncs);
+}
+
+int main(int argc, char **argv)
+{
+    options_t opt = { .ticks = 3000, .latency_ms = 40, .jitter_us = 500 };
+    bool use_pty = false;
+    int link[2];
+
+    for(int i = 1; i < argc; ++i)
+    {
+        if(!strcmp(argv[i], "-t")) { use_pty = true; continue; }
+        if(i + 1 >= argc) { usage(); return 1; }
+
+        if(!strcmp(argv[i], "-n"))      opt.ticks = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if(!strcmp(argv[i], "-l")) opt.latency_ms = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if(!strcmp(argv[i], "-j")) opt.jitter_us = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else { usage(); return 1; }
+    }
+
+    if(use_pty ? !open_pty(link) : socketpair(AF_UNIX, SOCK_STREAM, 0, link) != 0)
+    {
+        fprintf(stderr, "linkplay: cannot create the link\n");
+        return 1;
+    }
+
+    int results[2][2];
+    int hold[2];
+    pid_t pids[2];
+
+    if(pipe(hold) != 0) return 1;
+    for(int side = 0; side < 2; ++side)
+    {
+        if(pipe(results[side]) != 0) return 1;
+
+        pids[side] = fork();
+        if(pids[side] < 0) return 1;
+        if(pids[side] == 0)
+        {
+            close(link[1 - side]);
+            close(results[side][0]);
+            close(hold[1]);
+            run_side(link[side], results[side][1], hold[0], (uint16_t)(0x1234 + side * 0x1111), &opt);
+        }
+        close(results[side][1]);
+    }
+    close(link[0]);
+    close(link[1]);
+
+    close(hold[0]);
+
+    side_result_t r[2];
+    bool ok = true;
+    for(int side = 0; side < 2; ++side)
+    {
+        if(read(results[side][0], &r[side], sizeof(r[side])) != (ssize_t)sizeof(r[side]))
+        {
+            memset(&r[side], 0, sizeof(r[side]));
+        }
+        ok = ok && r[side].ok;
+    }
+
+    close(hold[1]);
+    waitpid(pids[0], NULL, 0);
+    waitpid(pids[1], NULL, 0);
+
+    printf("link       %s, %u ms latency, up to %u us jitter per tick\n",
+           use_pty ? "pty" : "socketpair", opt.latency_ms, opt.jitter_us);
+    print_side("board0", &r[0], opt.ticks);
+    print_side("board1", &r[1], opt.ticks);
+
+    bool agree = ok && r[0].hash == r[1].hash && !r[0].net.desyncs && !r[1].net.desyncs;
+    printf("sync       %s\n", agree ? "ok (final states match)" : "FAIL");
+
+    return agree ? 0 : 2;
+}
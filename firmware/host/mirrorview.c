@@ -0,0 +1,424 @@
+// Viewer for the framebuffer mirror stream (mirror.h).
+//
+// Decodes a capture of the stream, for example one taken from the board
+// with `cat /dev/ttyACM0 > capture.bin`, rebuilds the screen and writes it
+// out as a PPM image.
+//
+// With -r the game is first run on the host with the mirror writing to
+// the capture file at the simulated MIRROR_BAUD, and the rebuilt screen
+// is then compared with the simulated panel. Every pixel must match
+// except inside rectangles the stream reported as lost. -x adds an
+// incompressible block every tick to push the stream past what the UART
+// can carry. -t starts a new round every so many ticks, so the check also
+// covers the hardware scroll transition.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "f446re.h"
+#include "ili9341.h"
+#include "mirror.h"
+#include "perf.h"
+#include "pong.h"
+
+#define MAX_SIDE    320
+#define NOISE_SIDE  32
+
+typedef struct
+{
+    bool locked;
+    uint16_t w;
+    uint16_t h;
+    uint16_t scroll_head;   // hardware scroll, as in ili9341_set_scroll()
+    uint16_t scroll_tail;
+    uint16_t scroll_offset;
+    uint16_t pixels[MAX_SIDE * MAX_SIDE];
+    uint8_t stale[MAX_SIDE * MAX_SIDE];
+
+    uint32_t screens;
+    uint32_t windows;
+    uint32_t lost;
+    uint32_t scrolls;
+    uint32_t codes;
+    uint32_t skipped;       // bytes skipped looking for a screen packet
+    uint32_t errors;        // malformed packets
+} viewer_t;
+
+typedef struct
+{
+    const uint8_t *p;
+    const uint8_t *end;
+} cursor_t;
+
+static viewer_t g_view;
+static uint16_t g_noise[NOISE_SIDE * NOISE_SIDE];
+static uint32_t g_rng = 2463534242UL;
+
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: mirrorview [-r ticks [-x] [-t ticks]] [-o image.ppm] capture.bin\n"
+            "  -r ticks   run the game for this many ticks, recording the stream\n"
+            "             into capture.bin, then check the rebuilt screen\n"
+            "  -x         also draw a %ux%u block of noise every tick\n"
+            "  -t ticks   start a new round, with its scroll transition, this often\n"
+            "  -o path    write the rebuilt screen as a PPM image\n",
+            NOISE_SIDE, NOISE_SIDE);
+}
+
+static uint32_t next_rand(void)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return g_rng;
+}
+
+static bool get_u8(cursor_t *c, uint8_t *v)
+{
+    if(c->p >= c->end) return false;
+    *v = *c->p++;
+    return true;
+}
+
+static bool get_u16(cursor_t *c, uint16_t *v)
+{
+    if(c->end - c->p < 2) return false;
+    *v = (uint16_t)((c->p[0] << 8) | c->p[1]);
+    c->p += 2;
+    return true;
+}
+
+static bool get_rect(cursor_t *c, uint16_t r[4])
+{
+    for(int i = 0; i < 4; ++i)
+    {
+        if(!get_u16(c, &r[i])) return false;
+    }
+    return true;
+}
+
+static void put_pixel(const uint16_t win[4], uint32_t index, uint16_t color)
+{
+    uint32_t x = win[0] + index % win[2];
+    uint32_t y = win[1] + (index / win[2]) % win[3];
+
+    if(x >= g_view.w || y >= g_view.h) return;
+
+    g_view.pixels[y * MAX_SIDE + x] = color;
+    g_view.stale[y * MAX_SIDE + x] = 0;
+}
+
+// Index of the drawing-space pixel shown at screen position x, y
+static uint32_t view_index(uint32_t x, uint32_t y)
+{
+    const bool horizontal = g_view.w > g_view.h;
+    uint32_t a = horizontal ? x : y;
+    uint32_t head = g_view.scroll_head;
+    uint32_t lines = (horizontal ? g_view.w : g_view.h) - head - g_view.scroll_tail;
+
+    if(a >= head && a < head + lines) a = head + (a - head + g_view.scroll_offset) % lines;
+
+    return horizontal ? y * MAX_SIDE + a : a * MAX_SIDE + x;
+}
+
+static void mark_lost(const uint16_t r[4])
+{
+    for(uint32_t y = r[1]; y < (uint32_t)r[1] + r[3] && y < g_view.h; ++y)
+    {
+        for(uint32_t x = r[0]; x < (uint32_t)r[0] + r[2] && x < g_view.w; ++x)
+        {
+            g_view.stale[y * MAX_SIDE + x] = 1;
+        }
+    }
+}
+
+// Pixel codes up to the end of the window; false if the data runs out or
+// makes no sense
+static bool decode_window(cursor_t *c, const uint16_t win[4])
+{
+    uint32_t index = 0;
+    uint8_t code;
+
+    if(!win[2] || !win[3]) return false;
+
+    while(get_u8(c, &code))
+    {
+        uint16_t color;
+        uint32_t n;
+
+        g_view.codes++;
+
+        if(code == MIRROR_CODE_END) return true;
+
+        if(code < MIRROR_CODE_RUN)
+        {
+            for(n = code + 1U; n; --n)
+            {
+                if(!get_u16(c, &color)) return false;
+                put_pixel(win, index++, color);
+            }
+            continue;
+        }
+
+        if(code == MIRROR_CODE_LONG_RUN)
+        {
+            uint8_t b;
+            n = 0;
+            for(uint32_t shift = 0; ; shift += 7)
+            {
+                if(shift > 28 || !get_u8(c, &b)) return false;
+                n |= (uint32_t)(b & 0x7FU) << shift;
+                if(!(b & 0x80U)) break;
+            }
+        }
+        else
+        {
+            n = (code & 0x7FU) + 1U;
+        }
+
+        if(!get_u16(c, &color)) return false;
+        while(n--) put_pixel(win, index++, color);
+    }
+
+    return false;
+}
+
+static void decode(const uint8_t *data, size_t len)
+{
+    cursor_t c = { data, data + len };
+
+    while(c.p < c.end)
+    {
+        const uint8_t *start = c.p;
+        uint8_t sync, type;
+        uint16_t r[4];
+
+        if(!get_u8(&c, &sync) || !get_u8(&c, &type)) break;
+
+        // Until a screen packet, nothing else can be trusted
+        if(sync != MIRROR_SYNC || (!g_view.locked && type != MIRROR_PKT_SCREEN))
+        {
+            if(g_view.locked) g_view.errors++;
+            g_view.locked = false;
+            g_view.skipped++;
+            c.p = start + 1;
+            continue;
+        }
+
+        bool ok = false;
+        switch(type)
+        {
+            case MIRROR_PKT_SCREEN:
+                ok = get_u16(&c, &r[0]) && get_u16(&c, &r[1]) &&
+                     r[0] && r[1] && r[0] <= MAX_SIDE && r[1] <= MAX_SIDE;
+                if(ok)
+                {
+                    g_view.locked = true;
+                    g_view.w = r[0];
+                    g_view.h = r[1];
+                    g_view.scroll_head = 0;
+                    g_view.scroll_tail = 0;
+                    g_view.scroll_offset = 0;
+                    g_view.screens++;
+                }
+                break;
+
+            case MIRROR_PKT_SCROLL:
+                ok = get_u16(&c, &r[0]) && get_u16(&c, &r[1]) && get_u16(&c, &r[2]) &&
+                     (uint32_t)r[0] + r[1] < (uint32_t)(g_view.w > g_view.h ? g_view.w : g_view.h);
+                if(ok)
+                {
+                    g_view.scroll_head = r[0];
+                    g_view.scroll_tail = r[1];
+                    g_view.scroll_offset = r[2];
+                    g_view.scrolls++;
+                }
+                break;
+
+            case MIRROR_PKT_WINDOW:
+                ok = get_rect(&c, r) && decode_window(&c, r);
+                if(ok) g_view.windows++;
+                break;
+
+            case MIRROR_PKT_LOST:
+                ok = get_rect(&c, r);
+                if(ok)
+                {
+                    mark_lost(r);
+                    g_view.lost++;
+                }
+                break;
+
+            default:
+                break;
+        }
+
+        if(!ok)
+        {
+            if(c.p >= c.end) break; // capture cut short
+            g_view.errors++;
+            g_view.locked = false;
+            c.p = start + 1;
+        }
+    }
+}
+
+static bool write_ppm(const char *path)
+{
+    FILE *f = fopen(path, "wb");
+    if(!f) return false;
+
+    fprintf(f, "P6\n%u %u\n255\n", g_view.w, g_view.h);
+    for(uint32_t y = 0; y < g_view.h; ++y)
+    {
+        for(uint32_t x = 0; x < g_view.w; ++x)
+        {
+            uint16_t c = g_view.pixels[view_index(x, y)];
+            uint8_t rgb[3] = {
+                (uint8_t)(((c >> 11) & 0x1F) * 255 / 31),
+                (uint8_t)(((c >> 5) & 0x3F) * 255 / 63),
+                (uint8_t)((c & 0x1F) * 255 / 31)
+            };
+            fwrite(rgb, 1, 3, f);
+        }
+    }
+
+    return fclose(f) == 0;
+}
+
+static bool record(const char *path, uint32_t ticks, bool noise, uint32_t round)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) return false;
+
+    sim_reset();
+    sim_vcp_attach(fd);
+    mirror_init();
+    pong_init();
+
+    const mirror_stats_t *ms = mirror_get_stats();
+    uint32_t tick_max = 0;
+    uint16_t w, h;
+    ili9341_get_screen_size(&w, &h);
+
+    for(uint32_t n = 0; n < ticks; ++n)
+    {
+        uint32_t before = ms->bytes;
+
+        pong_run(1);
+        if(round && (n + 1) % round == 0) pong_new_round();
+
+        if(noise)
+        {
+            for(uint32_t i = 0; i < NOISE_SIDE * NOISE_SIDE; ++i) g_noise[i] = (uint16_t)next_rand();
+            ili9341_draw_buffer((uint16_t)(next_rand() % (w - NOISE_SIDE)),
+                                (uint16_t)(next_rand() % (h - NOISE_SIDE)),
+                                NOISE_SIDE, NOISE_SIDE, (const uint8_t *)g_noise);
+        }
+
+        if(ms->bytes - before > tick_max) tick_max = ms->bytes - before;
+    }
+
+    uint32_t backlog = mirror_pending();
+    mirror_flush();
+    sim_vcp_attach(-1);
+    close(fd);
+
+    double seconds = (double)sim_cycles() / PERF_CPU_HZ;
+    double line = (double)MIRROR_BAUD / 10.0;
+
+    printf("game       %u ticks, %.2f s simulated\n", ticks, seconds);
+    printf("stream     %u bytes, %.1f bytes/tick avg, %u max, %.1f%% of %lu baud\n",
+           ms->bytes, (double)ms->bytes / ticks, tick_max,
+           100.0 * ms->bytes / (seconds * line), (unsigned long)MIRROR_BAUD);
+    printf("windows    %u queued, %u lost on a full ring\n", ms->windows, ms->lost);
+    printf("pixels     %u coded, %.1f:1 against raw RGB565\n",
+           ms->pixels, ms->bytes ? 2.0 * ms->pixels / ms->bytes : 0.0);
+    printf("ring       %u of %u bytes peak, %u still queued at the end\n",
+           ms->ring_peak, MIRROR_RING, backlog);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t ticks = 0;
+    uint32_t round = 0;
+    bool noise = false;
+    const char *image = NULL;
+    const char *path = NULL;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        if(!strcmp(argv[i], "-x")) { noise = true; continue; }
+        if(argv[i][0] != '-') { path = argv[i]; continue; }
+        if(i + 1 >= argc) { usage(); return 1; }
+
+        if(!strcmp(argv[i], "-r"))      ticks = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if(!strcmp(argv[i], "-t")) round = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if(!strcmp(argv[i], "-o")) image = argv[++i];
+        else { usage(); return 1; }
+    }
+
+    if(!path) { usage(); return 1; }
+
+    if(ticks && !record(path, ticks, noise, round))
+    {
+        fprintf(stderr, "mirrorview: cannot write %s\n", path);
+        return 1;
+    }
+
+    FILE *f = fopen(path, "rb");
+    if(!f)
+    {
+        fprintf(stderr, "mirrorview: cannot read %s\n", path);
+        return 1;
+    }
+
+    static uint8_t data[64U << 20];
+    size_t len = fread(data, 1, sizeof(data), f);
+    fclose(f);
+
+    decode(data, len);
+
+    printf("viewer     %zu bytes, %u screen, %u window, %u scroll, %u lost packets, %u codes\n",
+           len, g_view.screens, g_view.windows, g_view.scrolls, g_view.lost, g_view.codes);
+    printf("           %u bytes skipped, %u errors, %ux%u screen\n",
+           g_view.skipped, g_view.errors, g_view.w, g_view.h);
+
+    if(image && !write_ppm(image))
+    {
+        fprintf(stderr, "mirrorview: cannot write %s\n", image);
+        return 1;
+    }
+
+    if(!ticks) return g_view.screens ? 0 : 2;
+
+    // Compare with what the simulated panel shows
+    uint16_t w, h;
+    uint32_t stale = 0, bad = 0;
+
+    sim_screen_size(&w, &h);
+    for(uint32_t y = 0; y < h; ++y)
+    {
+        for(uint32_t x = 0; x < w; ++x)
+        {
+            uint32_t i = view_index(x, y);
+            if(g_view.stale[i])
+            {
+                stale++;
+                continue;
+            }
+            if(g_view.pixels[i] != sim_read_pixel((uint16_t)x, (uint16_t)y)) bad++;
+        }
+    }
+
+    bool ok = w == g_view.w && h == g_view.h && !g_view.errors && !bad;
+    printf("check      %s (%u pixels differ, %u marked stale)\n", ok ? "ok" : "FAIL", bad, stale);
+
+    return ok ? 0 : 2;
+}
@@ -0,0 +1,116 @@
+// Runs the game loop on the host and reports the per-tick energy
+// accounting from power.c and the frame pacing from governor.c.
+//
+// The simulated clock only moves for modelled bus and GPIO time, so every
+// on-time tick must come out as exactly active + sleep = FRAME_MS, with
+// active equal to the bus time the tick used. Slowing the simulated SPI
+// down (-b) overloads the frame budget to exercise the governor. Past
+// what GOVERNOR_MAX_DIVIDER can absorb the game falls behind its tick
+// rate, and the run fails on pace.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "f446re.h"
+#include "governor.h"
+#include "perf.h"
+#include "pong.h"
+#include "power.h"
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: pongsim [-n ticks] [-b cycles]\n"
+            "  -n ticks   ticks to run (default 600)\n"
+            "  -b cycles  core cycles per SPI byte (default %u)\n",
+            SIM_CYCLES_PER_SPI_BYTE);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t ticks = 600;
+    uint32_t byte_cycles = SIM_CYCLES_PER_SPI_BYTE;
+
+    for(int i = 1; i < argc; ++i)
+    {
+        if(i + 1 >= argc) { usage(); return 1; }
+
+        if(!strcmp(argv[i], "-n"))      ticks = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if(!strcmp(argv[i], "-b")) byte_cycles = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else { usage(); return 1; }
+    }
+
+    sim_reset();
+    pong_init();
+    sim_set_spi_cycles_per_byte(byte_cycles);
+
+    const power_stats_t *ps = power_get_stats();
+    const governor_stats_t *gs = governor_get_stats();
+    const uint32_t period = PERF_MS_TO_CYCLES(FRAME_MS);
+    uint32_t divider_ticks[GOVERNOR_MAX_DIVIDER + 1] = { 0 };
+    uint32_t bad = 0;
+    uint64_t paced = 0;     // frame cycles of ticks 1.., without the setup
+
+    // The first tick also carries the setup time since power_init()
+    pong_run(1);
+    uint32_t active_max = ps->active_cycles;
+    bool late = ps->overrun_cycles != 0;
+
+    for(uint32_t n = 1; n < ticks; ++n)
+    {
+        uint64_t bus = sim_cycles();
+        pong_run(1);
+        bus = sim_cycles() - bus - ps->sleep_cycles;
+
+        // A tick that starts late has a short frame even when it ends on time
+        if(ps->active_cycles + ps->sleep_cycles != ps->frame_cycles ||
+           (!late && !ps->overrun_cycles && ps->frame_cycles != period) ||
+           ps->active_cycles != bus)
+        {
+            if(bad < 10)
+            {
+                printf("tick %u: frame %u active %u sleep %u (sim active %llu)\n",
+                       n, ps->frame_cycles, ps->active_cycles, ps->sleep_cycles,
+                       (unsigned long long)bus);
+            }
+            ++bad;
+        }
+
+        paced += ps->frame_cycles;
+        late = ps->overrun_cycles != 0;
+        if(ps->active_cycles > active_max) active_max = ps->active_cycles;
+        divider_ticks[gs->divider]++;
+    }
+
+    uint64_t total = ps->total_active + ps->total_sleep;
+    printf("ticks      %u (%u overruns)\n", ps->frames, ps->overruns);
+    printf("active     %.0f cycles/tick avg, %u max\n",
+           (double)ps->total_active / ps->frames, active_max);
+    printf("sleep      %.0f cycles/tick avg\n", (double)ps->total_sleep / ps->frames);
+    printf("duty       %u.%u%% awake\n", power_duty_permille() / 10U, power_duty_permille() % 10U);
+
+    printf("frames     %u drawn, %.1f fps\n", gs->frames, (double)gs->frames * PERF_CPU_HZ / total);
+    printf("render     %u cycles avg, %u max, budget %u\n",
+           gs->render_avg, gs->render_max, gs->budget_cycles);
+    printf("governor   %u over budget, %u shed, %u drops, %u raises, %u saturated\n",
+           gs->over_budget, gs->shed_frames, gs->rate_drops, gs->rate_raises, gs->saturated);
+    printf("divider   ");
+    for(uint32_t d = 1; d <= GOVERNOR_MAX_DIVIDER; ++d) printf(" 1/%u:%u", d, divider_ticks[d]);
+    printf(" ticks\n");
+
+    // Ticks must keep their rate, whatever the frame rate
+    const double expect = (double)(ticks - 1U) * period;
+    const bool slow = ticks > 1 && paced > expect * 1.01;
+    printf("pace       %s (%.1f s for %.1f s of ticks)\n",
+           slow ? "FAIL" : "ok", (double)paced / PERF_CPU_HZ, expect / PERF_CPU_HZ);
+
+    const arena_stats_t *as = arena_get_stats();
+    printf("arena      %u of %u bytes peak, %u failed requests\n", as->peak, as->size, as->failures);
+
+    printf("check      %s (%u bad ticks, %.3f s simulated)\n",
+           bad ? "FAIL" : "ok", bad, (double)total / PERF_CPU_HZ);
+
+    return (bad || slow) ? 2 : 0;
+}
@@ -0,0 +1,264 @@
+// Host replay of a game-state journal dumped from a board.
+//
+// Decodes every block, checks each tick against pong_step() run from the
+// previous tick (the paddle moves are taken from the recording), and
+// redraws it through the same draw code into the simulated panel. A block
+// flagged JOURNAL_BLOCK_RESTART starts over from its keyframe, as a new
+// round does, without being checked against the tick before. Frames
+// can be written out as PPM images, and the bus cost of every frame is
+// reported so rendering changes can be compared on recorded play.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ai.h"
+#include "f446re.h"
+#include "ili9341.h"
+#include "journal.h"
+#include "pong.h"
+
+typedef struct
+{
+    bool have_prev;
+    uint32_t last_tick;
+    bool restart;           // the block being decoded opens on a restart
+    pong_state_t state;
+    pong_vel_t vel;
+
+    const char *out_dir;
+    uint32_t every;
+
+    uint32_t ticks;
+    uint32_t mismatches;
+    uint32_t gaps;
+    uint32_t restarts;
+    uint32_t frames;        // ticks drawn as a diff against the one before
+    uint64_t frame_cycles;
+    uint64_t frame_cycles_max;
+} replay_ctx_t;
+
+static journal_t g_dump;
+
+
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: replay [-o dir] [-n every] <journal.bin>\n"
+            "       replay -r ticks [-t round] <journal.bin>\n"
+            "  -o dir    write frames as dir/frame_<tick>.ppm\n"
+            "  -n every  write every n-th frame (default 1)\n"
+            "  -r ticks  play ticks on the host and write their journal\n"
+            "  -t round  with -r, start a new round every round ticks\n");
+}
+
+static bool visit_tick(uint32_t tick, const pong_state_t *state, const pong_vel_t *vel, void *user)
+{
+    replay_ctx_t *ctx = user;
+
+    bool restart = ctx->restart;
+    ctx->restart = false;
+
+    if(ctx->have_prev && tick == ctx->last_tick + 1U && !restart)
+    {
+        pong_state_t pstate = ctx->state;
+        pong_vel_t pvel = ctx->vel;
+        pong_input_t input = {
+            .l_dy = (int16_t)(state->l_y - pstate.l_y),
+            .r_dy = (int16_t)(state->r_y - pstate.r_y)
+        };
+        pong_step(&pstate, &pvel, &input);
+
+        if(memcmp(&pstate, state, sizeof(pstate)) != 0 || memcmp(&pvel, vel, sizeof(pvel)) != 0)
+        {
+            if(ctx->mismatches < 10)
+            {
+                printf("tick %u: recorded ball (%d,%d) v(%d,%d) paddles %d/%d, "
+                       "pong_step gives ball (%d,%d) v(%d,%d) paddles %d/%d\n",
+                       tick, state->b_x, state->b_y, vel->b_dx, vel->b_dy, state->l_y, state->r_y,
+                       pstate.b_x, pstate.b_y, pvel.b_dx, pvel.b_dy, pstate.l_y, pstate.r_y);
+            }
+            ++ctx->mismatches;
+        }
+
+        uint64_t start = sim_stats()->bus_cycles;
+        pong_draw_frame(&ctx->state, state);
+        uint64_t cycles = sim_stats()->bus_cycles - start;
+
+        ctx->frame_cycles += cycles;
+        if(cycles > ctx->frame_cycles_max) ctx->frame_cycles_max = cycles;
+        ++ctx->frames;
+    }
+    else
+    {
+        // First tick, a new round or a hole left by an overwritten block:
+        // redraw everything
+        if(restart) ++ctx->restarts;
+        else if(ctx->have_prev) ++ctx->gaps;
+        pong_draw_field(state);
+    }
+
+    ctx->have_prev = true;
+    ctx->last_tick = tick;
+    ctx->state = *state;
+    ctx->vel = *vel;
+    ++ctx->ticks;
+
+    if(ctx->out_dir && tick % ctx->every == 0)
+    {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/frame_%08u.ppm", ctx->out_dir, tick);
+        if(!sim_write_ppm(path))
+        {
+            fprintf(stderr, "replay: cannot write %s\n", path);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static int cmp_first_tick(const void *a, const void *b)
+{
+    const journal_block_t *x = *(const journal_block_t * const *)a;
+    const journal_block_t *y = *(const journal_block_t * const *)b;
+    return (x->first_tick > y->first_tick) - (x->first_tick < y->first_tick);
+}
+
+static int record(uint32_t ticks, uint32_t round_ticks, const char *path)
+{
+    pong_state_t state;
+    pong_vel_t vel;
+
+    ai_config_t ai_config = {
+        .reaction_ticks = AI_REACTION_TICKS,
+        .error_px = AI_ERROR_PX,
+        .seed = 1
+    };
+
+    uint16_t width, height;
+
+    ili9341_get_screen_size(&width, &height);
+    pong_reset(&state, &vel);
+    ai_init(&ai_config, (int16_t)height);
+    journal_init();
+
+    for(uint32_t i = 0; i < ticks; ++i)
+    {
+        pong_input_t input;
+
+        if(round_ticks && i && i % round_ticks == 0)
+        {
+            // As pong_new_round() does in attract mode
+            pong_reset(&state, &vel);
+            ai_init(&ai_config, (int16_t)height);
+            journal_restart();
+        }
+
+        ai_update(&state, &vel, &input);
+        pong_step(&state, &vel, &input);
+        journal_record(&state, &vel);
+    }
+
+    FILE *f = fopen(path, "wb");
+    if(!f || fwrite(journal_get(), sizeof(journal_t), 1, f) != 1)
+    {
+        fprintf(stderr, "replay: cannot write %s\n", path);
+        if(f) fclose(f);
+        return 1;
+    }
+    fclose(f);
+
+    printf("recorded %u ticks\n", ticks);
+    return 0;
+}
+
+static int replay(const char *path, const char *out_dir, uint32_t every)
+{
+    FILE *f = fopen(path, "rb");
+    if(!f)
+    {
+        fprintf(stderr, "replay: cannot open %s\n", path);
+        return 1;
+    }
+    size_t got = fread(&g_dump, 1, sizeof(g_dump), f);
+    fclose(f);
+
+    if(got != sizeof(g_dump) || g_dump.magic != JOURNAL_MAGIC)
+    {
+        fprintf(stderr, "replay: %s is not a journal dump (%zu bytes)\n", path, got);
+        return 1;
+    }
+    if(g_dump.version != JOURNAL_VERSION ||
+       g_dump.block_size != JOURNAL_BLOCK_SIZE ||
+       g_dump.block_count != JOURNAL_BLOCK_COUNT)
+    {
+        fprintf(stderr, "replay: journal v%u %ux%u, tool built for v%u %ux%u\n",
+                g_dump.version, g_dump.block_count, g_dump.block_size,
+                JOURNAL_VERSION, JOURNAL_BLOCK_COUNT, JOURNAL_BLOCK_SIZE);
+        return 1;
+    }
+
+    const journal_block_t *order[JOURNAL_BLOCK_COUNT];
+    uint32_t nblocks = 0;
+    uint32_t payload = 0;
+    for(uint32_t i = 0; i < JOURNAL_BLOCK_COUNT; ++i)
+    {
+        if(g_dump.blocks[i].ticks == 0) continue;
+        order[nblocks++] = &g_dump.blocks[i];
+        payload += JOURNAL_BLOCK_HEADER + g_dump.blocks[i].used;
+    }
+    qsort(order, nblocks, sizeof(order[0]), cmp_first_tick);
+
+    replay_ctx_t ctx = { .out_dir = out_dir, .every = every };
+    for(uint32_t i = 0; i < nblocks; ++i)
+    {
+        ctx.restart = (order[i]->flags & JOURNAL_BLOCK_RESTART) != 0U;
+        if(journal_decode_block(order[i], visit_tick, &ctx) < 0)
+        {
+            fprintf(stderr, "replay: block at tick %u is corrupt\n", order[i]->first_tick);
+            return 1;
+        }
+    }
+
+    printf("ticks      %u of %u recorded (%u blocks, %u restarts, %u gaps)\n",
+           ctx.ticks, g_dump.ticks, nblocks, ctx.restarts, ctx.gaps);
+    printf("journal    %u bytes, %.2f bytes/tick, %.1f s of play held\n",
+           payload, ctx.ticks ? (double)payload / ctx.ticks : 0.0,
+           (double)ctx.ticks * FRAME_MS / 1000.0);
+    printf("mismatches %u\n", ctx.mismatches);
+    if(ctx.frames)
+    {
+        printf("bus        %.0f cycles/frame avg, %llu max\n",
+               (double)ctx.frame_cycles / ctx.frames, (unsigned long long)ctx.frame_cycles_max);
+    }
+
+    return ctx.mismatches ? 2 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *out_dir = NULL;
+    uint32_t every = 1;
+    uint32_t record_ticks = 0;
+    uint32_t round_ticks = 0;
+    int i = 1;
+
+    for(; i < argc && argv[i][0] == '-'; ++i)
+    {
+        if(i + 1 >= argc) { usage(); return 1; }
+
+        if(!strcmp(argv[i], "-o"))      out_dir = argv[++i];
+        else if(!strcmp(argv[i], "-n")) every = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if(!strcmp(argv[i], "-r")) record_ticks = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else if(!strcmp(argv[i], "-t")) round_ticks = (uint32_t)strtoul(argv[++i], NULL, 0);
+        else { usage(); return 1; }
+    }
+    if(i + 1 != argc || every == 0) { usage(); return 1; }
+
+    sim_reset();
+    pong_init();
+
+    if(record_ticks) return record(record_ticks, round_ticks, argv[i]);
+    return replay(argv[i], out_dir, every);
+}
@@ -0,0 +1,258 @@
+// Hardware scroll check.
+//
+// Runs pushes and marquees through scroll.h in all four rotations and
+// with fixed areas at either end, reading the simulated panel back after
+// every frame and comparing it with where each line of the old and new
+// pictures should be by then. Then runs the game's new-round transition
+// and checks it leaves the same screen as a full repaint, and compares
+// the bus bytes per frame with a full redraw.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "f446re.h"
+#include "ili9341.h"
+#include "pong.h"
+#include "scroll.h"
+
+#define MAX_SIDE    320
+#define STEP        8
+#define MARQUEE     100         // frames
+
+typedef struct
+{
+    uint16_t head;
+    uint16_t tail;
+} area_t;
+
+static const area_t g_areas[] = { { 0, 0 }, { 16, 32 }, { 40, 0 }, { 0, 24 } };
+
+static uint16_t g_view[MAX_SIDE * MAX_SIDE];
+static uint16_t g_across;       // screen size across the scroll axis
+static uint16_t g_salt;         // picks the picture
+static uint32_t g_failures;
+
+
+// Each picture line is two colors split across the axis, so a line drawn
+// transposed or mirrored does not pass
+static uint16_t line_color(uint32_t source, uint16_t b, uint16_t salt)
+{
+    uint32_t c = (source + 1U) * 40503U + salt * 2654435761U + (b < g_across / 2 ? 0U : 0x5555U);
+    return (uint16_t)(c ^ (c >> 16));
+}
+
+static void paint_lines(uint16_t line, uint16_t count, uint32_t source)
+{
+    const bool horizontal = ili9341_scroll_horizontal();
+    const uint16_t half = (uint16_t)(g_across / 2);
+
+    for(uint16_t i = 0; i < count; ++i)
+    {
+        uint16_t at = (uint16_t)(line + i);
+        uint16_t c0 = line_color(source + i, 0, g_salt);
+        uint16_t c1 = line_color(source + i, half, g_salt);
+
+        if(horizontal)
+        {
+            ili9341_draw_vline(at, 0, half, c0);
+            ili9341_draw_vline(at, half, (uint16_t)(g_across - half), c1);
+        }
+        else
+        {
+            ili9341_draw_hline(0, at, half, c0);
+            ili9341_draw_hline(half, at, (uint16_t)(g_across - half), c1);
+        }
+    }
+}
+
+// Compares the screen with `expect`, which maps a screen line to the
+// picture line and salt it should show
+static bool check_screen(const char *what, uint32_t frame,
+                         void (*expect)(uint16_t a, uint32_t *source, uint16_t *salt))
+{
+    const bool horizontal = ili9341_scroll_horizontal();
+    uint16_t w, h;
+    sim_screen_size(&w, &h);
+
+    for(uint16_t y = 0; y < h; ++y)
+    {
+        for(uint16_t x = 0; x < w; ++x)
+        {
+            uint16_t a = horizontal ? x : y;
+            uint16_t b = horizontal ? y : x;
+            uint32_t source;
+            uint16_t salt;
+
+            expect(a, &source, &salt);
+            if(sim_read_pixel(x, y) != line_color(source, b, salt))
+            {
+                printf("  %s frame %u: wrong pixel at %u,%u\n", what, frame, x, y);
+                g_failures++;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static uint16_t g_head;
+static uint16_t g_lines;
+static uint32_t g_shifted;      // lines scrolled since the last picture
+
+// Push: the old picture moves towards the head, the new one follows it.
+// The fixed areas keep the old picture throughout.
+static void expect_push(uint16_t a, uint32_t *source, uint16_t *salt)
+{
+    *source = a;
+    *salt = 1;
+    if(a < g_head || a >= g_head + g_lines) return;
+
+    uint32_t p = a + g_shifted;
+    if(p < (uint32_t)g_head + g_lines) *source = p;
+    else
+    {
+        *source = p - g_lines;
+        *salt = 2;
+    }
+}
+
+// Marquee: the stream comes in after the far end of the new picture
+static void expect_marquee(uint16_t a, uint32_t *source, uint16_t *salt)
+{
+    *source = a;
+    *salt = 1;
+    if(a < g_head || a >= g_head + g_lines) return;
+
+    uint32_t p = (uint32_t)(a - g_head) + g_shifted;
+    if(p < g_lines)
+    {
+        *source = (uint32_t)g_head + p;
+        *salt = 2;
+    }
+    else
+    {
+        *source = p - g_lines;
+        *salt = 3;
+    }
+}
+
+static void run_area(ili9341_rot_t rot, area_t area)
+{
+    uint16_t w, h;
+    ili9341_set_rotation(rot);
+    ili9341_get_screen_size(&w, &h);
+
+    const bool horizontal = ili9341_scroll_horizontal();
+    const uint16_t length = horizontal ? w : h;
+    g_across = horizontal ? h : w;
+
+    // Old picture, drawn straight
+    g_salt = 1;
+    paint_lines(0, length, 0);
+
+    g_head = area.head;
+    g_lines = (uint16_t)(length - area.head - area.tail);
+    g_shifted = 0;
+
+    char what[64];
+    snprintf(what, sizeof(what), "rot %d head %u tail %u push", (int)rot, area.head, area.tail);
+
+    scroll_begin(area.head, area.tail);
+    g_salt = 2;
+
+    bool done = false;
+    for(uint32_t frame = 0; !done; ++frame)
+    {
+        done = scroll_push(STEP, paint_lines);
+        g_shifted += STEP;
+        if(g_shifted > g_lines) g_shifted = g_lines;
+        if(!check_screen(what, frame, expect_push)) return;
+    }
+    if(scroll_offset() != 0)
+    {
+        printf("  %s: ended at offset %u\n", what, scroll_offset());
+        g_failures++;
+        return;
+    }
+
+    // Then an endless scroll carrying on from the new picture
+    snprintf(what, sizeof(what), "rot %d head %u tail %u marquee", (int)rot, area.head, area.tail);
+    g_salt = 3;
+    g_shifted = 0;
+    for(uint32_t frame = 0; frame < MARQUEE; ++frame)
+    {
+        scroll_marquee(STEP, paint_lines);
+        g_shifted += STEP;
+        if(!check_screen(what, frame, expect_marquee)) return;
+    }
+
+    scroll_end();
+}
+
+static void snapshot(void)
+{
+    uint16_t w, h;
+    sim_screen_size(&w, &h);
+    for(uint16_t y = 0; y < h; ++y)
+    {
+        for(uint16_t x = 0; x < w; ++x) g_view[y * MAX_SIDE + x] = sim_read_pixel(x, y);
+    }
+}
+
+static uint32_t differ(void)
+{
+    uint16_t w, h;
+    uint32_t bad = 0;
+    sim_screen_size(&w, &h);
+    for(uint16_t y = 0; y < h; ++y)
+    {
+        for(uint16_t x = 0; x < w; ++x) bad += g_view[y * MAX_SIDE + x] != sim_read_pixel(x, y);
+    }
+    return bad;
+}
+
+int main(void)
+{
+    sim_reset();
+    pong_init();
+
+    for(int rot = ILI9341_ROT_0; rot <= ILI9341_ROT_270; ++rot)
+    {
+        for(size_t i = 0; i < sizeof(g_areas) / sizeof(g_areas[0]); ++i)
+        {
+            run_area((ili9341_rot_t)rot, g_areas[i]);
+        }
+    }
+    printf("patterns   %u rotations x %zu areas, %s\n",
+           ILI9341_ROT_270 + 1, sizeof(g_areas) / sizeof(g_areas[0]),
+           g_failures ? "FAIL" : "ok");
+
+    // The game's transition must end on the same screen as a full repaint
+    sim_reset();
+    pong_init();
+
+    pong_state_t state;
+    pong_vel_t vel;
+    pong_reset(&state, &vel);
+
+    uint32_t bytes = ili9341_get_tx_bytes();
+    pong_draw_field(&state);
+    uint32_t full = ili9341_get_tx_bytes() - bytes;
+    snapshot();
+
+    pong_run(250);
+    pong_new_round();
+
+    const scroll_stats_t *ss = scroll_get_stats();
+    uint32_t bad = differ();
+    if(bad) g_failures++;
+
+    printf("round      %u frames of %u lines, %s (%u pixels differ)\n",
+           ss->frames, WIPE_STEP, bad ? "FAIL" : "ok", bad);
+    printf("bus        %.0f bytes/frame avg, %u max, against %u for a full redraw\n",
+           ss->frames ? (double)ss->bytes_total / ss->frames : 0.0, ss->bytes_max, full);
+    printf("           %u bytes for the whole transition, %.1f%% of a full redraw\n",
+           ss->bytes_total, 100.0 * ss->bytes_total / full);
+
+    return g_failures ? 2 : 0;
+}
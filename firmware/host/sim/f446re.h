@@ -0,0 +1,98 @@
+#ifndef HOST_F446RE_H
+#define HOST_F446RE_H
+
+// Host stand-in for the f446re driver library.
+//
+// Provides just the subset of the driver API the app uses, backed by the
+// simulator in sim.c: GPIO writes and SPI bytes are fed to an emulated
+// ILI9341 panel, and every call advances a simulated cycle counter.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sim.h"
+
+#define ENABLE  1
+#define DISABLE 0
+
+typedef struct { uint8_t id; } gpio_regdef_t;
+typedef struct { uint8_t id; } spi_regdef_t;
+
+extern gpio_regdef_t g_sim_gpiob;
+extern spi_regdef_t g_sim_spi2;
+
+#define GPIOB (&g_sim_gpiob)
+#define SPI2  (&g_sim_spi2)
+
+#define GPIO_PIN_5  5
+#define GPIO_PIN_6  6
+#define GPIO_PIN_7  7
+#define GPIO_PIN_13 13
+#define GPIO_PIN_14 14
+#define GPIO_PIN_15 15
+
+#define GPIO_MODE_OUTPUT 1
+#define GPIO_MODE_ALTFN  2
+#define GPIO_OTYPE_PP    0
+#define GPIO_PUPD_DI     0
+#define GPIO_SPEED_HIGH  2
+
+#define SPI_MODE_MASTER     1
+#define SPI_BUS_FULL_DUPLEX 1
+#define SPI_BAUD_DIV2       0
+#define SPI_DF_8BIT         0
+#define SPI_FF_MSB_FIRST    0
+#define SPI_CPOL_LOW        0
+#define SPI_CPHA_1EDGE      0
+#define SPI_SSM_SOFTWARE    1
+
+#define SPI_FLAG_TXE  (1U << 1)
+#define SPI_FLAG_BUSY (1U << 7)
+
+typedef struct
+{
+    uint8_t pin_num;
+    uint8_t mode;
+    uint8_t speed;
+    uint8_t pupd;
+    uint8_t otype;
+    uint8_t altfn;
+} gpio_config_t;
+
+typedef struct
+{
+    gpio_regdef_t *gpiox;
+    gpio_config_t config;
+} gpio_handle_t;
+
+typedef struct
+{
+    uint8_t device_mode;
+    uint8_t bus_config;
+    uint8_t baud;
+    uint8_t df;
+    uint8_t ff;
+    uint8_t cpol;
+    uint8_t cpha;
+    uint8_t ssm;
+} spi_config_t;
+
+typedef struct
+{
+    spi_regdef_t *spix;
+    spi_config_t config;
+} spi_handle_t;
+
+void gpio_init(gpio_handle_t *handle);
+void gpio_write_pin(gpio_regdef_t *gpiox, uint8_t pin, uint8_t value);
+
+void spi_init(spi_handle_t *handle);
+void spi_peripheral_control(spi_regdef_t *spix, uint8_t enable);
+void spi_send(spi_regdef_t *spix, const uint8_t *data, uint32_t len);
+uint8_t spi_flag_status(spi_regdef_t *spix, uint32_t flag);
+
+void dwt_init(void);
+void dwt_delay_us(uint32_t us);
+void dwt_delay_ms(uint32_t ms);
+
+#endif
@@ -0,0 +1,391 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include "f446re.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "ili9341.h"
+
+gpio_regdef_t g_sim_gpiob;
+spi_regdef_t g_sim_spi2;
+
+// Emulated ILI9341 controller state
+typedef struct
+{
+    bool cs;                // true while selected (CS low)
+    bool dc;                // true for data
+    uint8_t cmd;
+    uint8_t params[6];
+    uint32_t param_idx;
+    uint16_t xs, xe, ys, ye;
+    uint16_t cx, cy;
+    uint8_t hi;             // first byte of a pixel pair
+    bool have_hi;
+    uint8_t madctl;
+    uint16_t tfa, vsa, bfa; // vertical scroll definition, in panel rows
+    uint16_t vsp;           // scroll start address
+    uint16_t gram[SIM_PANEL_H][SIM_PANEL_W];
+} sim_panel_t;
+
+static sim_panel_t g_panel;
+static sim_stats_t g_stats;
+static uint64_t g_cycles;
+static uint32_t g_spi_byte_cycles = SIM_CYCLES_PER_SPI_BYTE;
+static uint64_t g_spi_idle_at;      // when the last byte sent is off the wire
+static uint64_t g_async_idle_at;    // the same for interrupt-sent bytes
+
+
+static void map_to_gram(uint16_t c, uint16_t p, uint16_t *col, uint16_t *row)
+{
+    uint16_t cc = c, rr = p;
+
+    if(g_panel.madctl & MADCTL_MV)
+    {
+        cc = p;
+        rr = c;
+    }
+    if(g_panel.madctl & MADCTL_MX) cc = (uint16_t)(SIM_PANEL_W - 1 - cc);
+    if(g_panel.madctl & MADCTL_MY) rr = (uint16_t)(SIM_PANEL_H - 1 - rr);
+
+    *col = cc;
+    *row = rr;
+}
+
+// Panel row the display shows on a given row, as the gate scan sees it
+static uint16_t scroll_row(uint16_t row)
+{
+    if(row < g_panel.tfa || row >= g_panel.tfa + g_panel.vsa) return row;
+
+    uint32_t r = (uint32_t)g_panel.vsp + (row - g_panel.tfa);
+    if(r >= (uint32_t)g_panel.tfa + g_panel.vsa) r -= g_panel.vsa;
+    return (uint16_t)r;
+}
+
+static void panel_pixel(uint16_t color)
+{
+    uint16_t col, row;
+
+    if(g_panel.cy > g_panel.ye) return; // past the window, ignored like the panel does
+
+    map_to_gram(g_panel.cx, g_panel.cy, &col, &row);
+    if(col < SIM_PANEL_W && row < SIM_PANEL_H) g_panel.gram[row][col] = color;
+
+    if(++g_panel.cx > g_panel.xe)
+    {
+        g_panel.cx = g_panel.xs;
+        ++g_panel.cy;
+    }
+}
+
+static void panel_command(uint8_t cmd)
+{
+    g_panel.cmd = cmd;
+    g_panel.param_idx = 0;
+    g_panel.have_hi = false;
+
+    if(cmd == ILI9341_CMD_MEMORY_WRITE)
+    {
+        g_panel.cx = g_panel.xs;
+        g_panel.cy = g_panel.ys;
+    }
+}
+
+static void panel_data(uint8_t b)
+{
+    switch(g_panel.cmd)
+    {
+        case ILI9341_CMD_MEMORY_WRITE:
+            ++g_stats.pixel_bytes;
+            if(!g_panel.have_hi)
+            {
+                g_panel.hi = b;
+                g_panel.have_hi = true;
+            }
+            else
+            {
+                g_panel.have_hi = false;
+                panel_pixel((uint16_t)((g_panel.hi << 8) | b));
+            }
+            return;
+
+        case ILI9341_CMD_COLUMN_ADDR:
+        case ILI9341_CMD_PAGE_ADDR:
+            ++g_stats.param_bytes;
+            if(g_panel.param_idx < 4) g_panel.params[g_panel.param_idx] = b;
+            if(++g_panel.param_idx == 4)
+            {
+                uint16_t a0 = (uint16_t)((g_panel.params[0] << 8) | g_panel.params[1]);
+                uint16_t a1 = (uint16_t)((g_panel.params[2] << 8) | g_panel.params[3]);
+                if(g_panel.cmd == ILI9341_CMD_COLUMN_ADDR) { g_panel.xs = a0; g_panel.xe = a1; }
+                else                                       { g_panel.ys = a0; g_panel.ye = a1; }
+            }
+            return;
+
+        case ILI9341_CMD_MEMORY_ACCESS:
+            ++g_stats.param_bytes;
+            g_panel.madctl = b;
+            return;
+
+        case ILI9341_CMD_VERT_SCROLL_DEF:
+            ++g_stats.param_bytes;
+            if(g_panel.param_idx < 6) g_panel.params[g_panel.param_idx] = b;
+            if(++g_panel.param_idx == 6)
+            {
+                uint16_t tfa = (uint16_t)((g_panel.params[0] << 8) | g_panel.params[1]);
+                uint16_t vsa = (uint16_t)((g_panel.params[2] << 8) | g_panel.params[3]);
+                uint16_t bfa = (uint16_t)((g_panel.params[4] << 8) | g_panel.params[5]);
+
+                // The panel ignores a definition that does not add up
+                if(tfa + vsa + bfa == SIM_PANEL_H)
+                {
+                    g_panel.tfa = tfa;
+                    g_panel.vsa = vsa;
+                    g_panel.bfa = bfa;
+                }
+            }
+            return;
+
+        case ILI9341_CMD_VERT_SCROLL_ADDR:
+            ++g_stats.param_bytes;
+            if(g_panel.param_idx < 2) g_panel.params[g_panel.param_idx] = b;
+            if(++g_panel.param_idx == 2)
+            {
+                g_panel.vsp = (uint16_t)((g_panel.params[0] << 8) | g_panel.params[1]);
+            }
+            return;
+
+        default:
+            ++g_stats.param_bytes;
+            return;
+    }
+}
+
+void sim_reset(void)
+{
+    memset(&g_panel, 0, sizeof(g_panel));
+    g_panel.vsa = SIM_PANEL_H;
+    memset(&g_stats, 0, sizeof(g_stats));
+    g_cycles = 0;
+    g_spi_byte_cycles = SIM_CYCLES_PER_SPI_BYTE;
+    g_spi_idle_at = 0;
+    g_async_idle_at = 0;
+}
+
+void sim_set_spi_cycles_per_byte(uint32_t cycles)
+{
+    g_spi_byte_cycles = cycles;
+}
+
+uint64_t sim_cycles(void)
+{
+    return g_cycles;
+}
+
+void sim_advance(uint64_t cycles)
+{
+    g_cycles += cycles;
+}
+
+uint64_t sim_host_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+const sim_stats_t *sim_stats(void)
+{
+    return &g_stats;
+}
+
+void sim_clear_stats(void)
+{
+    memset(&g_stats, 0, sizeof(g_stats));
+}
+
+void sim_screen_size(uint16_t *width, uint16_t *height)
+{
+    if(g_panel.madctl & MADCTL_MV)
+    {
+        *width = SIM_PANEL_H;
+        *height = SIM_PANEL_W;
+    }
+    else
+    {
+        *width = SIM_PANEL_W;
+        *height = SIM_PANEL_H;
+    }
+}
+
+uint16_t sim_read_pixel(uint16_t x, uint16_t y)
+{
+    uint16_t w, h, col, row;
+
+    sim_screen_size(&w, &h);
+    if(x >= w || y >= h) return 0;
+
+    map_to_gram(x, y, &col, &row);
+    return g_panel.gram[scroll_row(row)][col];
+}
+
+bool sim_write_ppm(const char *path)
+{
+    uint16_t w, h;
+    FILE *f = fopen(path, "wb");
+    if(!f) return false;
+
+    sim_screen_size(&w, &h);
+    fprintf(f, "P6\n%u %u\n255\n", w, h);
+
+    for(uint16_t y = 0; y < h; ++y)
+    {
+        for(uint16_t x = 0; x < w; ++x)
+        {
+            uint16_t c = sim_read_pixel(x, y);
+            uint8_t rgb[3] = {
+                (uint8_t)(((c >> 11) & 0x1F) * 255 / 31),
+                (uint8_t)(((c >> 5) & 0x3F) * 255 / 63),
+                (uint8_t)((c & 0x1F) * 255 / 31)
+            };
+            fwrite(rgb, 1, 3, f);
+        }
+    }
+
+    return fclose(f) == 0;
+}
+
+// ---------------------------------------------------------------------------
+// Driver API
+
+void gpio_init(gpio_handle_t *handle)
+{
+    (void)handle;
+}
+
+static void set_pin(uint8_t pin, uint8_t value)
+{
+    if(pin == ILI9341_CS_PIN)
+    {
+        bool selected = (value == 0);
+        if(g_panel.cs && !selected) ++g_stats.transactions;
+        g_panel.cs = selected;
+    }
+    else if(pin == ILI9341_DC_PIN)
+    {
+        g_panel.dc = (value != 0);
+    }
+    else if(pin == ILI9341_RST_PIN && value == 0)
+    {
+        g_panel.madctl = 0;
+    }
+}
+
+static void send_bytes(const uint8_t *data, uint32_t len)
+{
+    g_stats.bus_cycles += (uint64_t)len * g_spi_byte_cycles;
+
+    while(len--)
+    {
+        uint8_t b = *data++;
+        if(!g_panel.cs) continue;
+
+        if(!g_panel.dc)
+        {
+            ++g_stats.cmd_bytes;
+            panel_command(b);
+        }
+        else
+        {
+            panel_data(b);
+        }
+    }
+}
+
+void gpio_write_pin(gpio_regdef_t *gpiox, uint8_t pin, uint8_t value)
+{
+    // A line change under a byte still shifting out would corrupt it
+    if(gpiox == GPIOB && pin != ILI9341_RST_PIN && g_cycles < g_spi_idle_at) ++g_stats.early_lines;
+
+    g_cycles += SIM_CYCLES_PER_GPIO;
+    if(gpiox != GPIOB) return;
+
+    set_pin(pin, value);
+}
+
+void spi_init(spi_handle_t *handle)
+{
+    (void)handle;
+}
+
+void spi_peripheral_control(spi_regdef_t *spix, uint8_t enable)
+{
+    (void)spix;
+    (void)enable;
+}
+
+void spi_send(spi_regdef_t *spix, const uint8_t *data, uint32_t len)
+{
+    (void)spix;
+
+    if(!len) return;
+
+    if(g_cycles < g_async_idle_at) ++g_stats.overlaps;
+
+    // The first byte waits for the shifter if the last call's final byte is
+    // still in it; the call returns once its own final byte has gone in
+    uint64_t start = g_cycles + SIM_CYCLES_PER_SPI_CALL;
+    if(start < g_spi_idle_at) start = g_spi_idle_at;
+
+    g_spi_idle_at = start + (uint64_t)len * g_spi_byte_cycles;
+    g_cycles = g_spi_idle_at - g_spi_byte_cycles;
+    send_bytes(data, len);
+}
+
+uint8_t spi_flag_status(spi_regdef_t *spix, uint32_t flag)
+{
+    (void)spix;
+
+    if(flag & SPI_FLAG_TXE) return 1U;
+    if(!(flag & SPI_FLAG_BUSY) || g_cycles >= g_spi_idle_at) return 0U;
+
+    // Busy: the caller spins until the last byte is out
+    ++g_stats.busy_waits;
+    g_stats.busy_cycles += g_spi_idle_at - g_cycles;
+    g_cycles = g_spi_idle_at;
+    return 1U;
+}
+
+void sim_spi_async(const uint8_t *data, uint32_t len)
+{
+    if(g_spi_idle_at < g_cycles) g_spi_idle_at = g_cycles;
+    g_spi_idle_at += (uint64_t)len * g_spi_byte_cycles;
+    g_async_idle_at = g_spi_idle_at;
+    send_bytes(data, len);
+}
+
+void sim_pin_async(uint8_t pin, uint8_t value)
+{
+    // The panel has taken the bytes before it already
+    set_pin(pin, value);
+}
+
+uint64_t sim_spi_idle_at(void)
+{
+    return g_spi_idle_at;
+}
+
+void dwt_init(void)
+{
+}
+
+void dwt_delay_us(uint32_t us)
+{
+    g_cycles += (uint64_t)us * (SIM_CPU_HZ / 1000000UL);
+}
+
+void dwt_delay_ms(uint32_t ms)
+{
+    g_cycles += (uint64_t)ms * (SIM_CPU_HZ / 1000UL);
+}
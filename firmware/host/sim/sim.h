@@ -0,0 +1,194 @@
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Simulated core clock and SPI timing. SPI2 runs at PCLK1/2 with the core
+// on the 16 MHz HSI, so each byte on the wire takes 16 core cycles.
+#define SIM_CPU_HZ              16000000UL
+#define SIM_CYCLES_PER_SPI_BYTE 16U
+#define SIM_CYCLES_PER_SPI_CALL 12U
+#define SIM_CYCLES_PER_GPIO     6U
+#define SIM_CYCLES_PER_SPI_IRQ  40U // entry, one queue entry, exit
+#define SIM_CYCLES_PER_SPI_PUT  8U  // one entry into the queue
+
+// Composing pixels in RAM (balls.c): memset clears a word, two pixels, per
+// store; a composed pixel is two byte stores and the loop branch; each
+// rectangle pays for its clipping and each of its rows for the row setup
+#define SIM_CYCLES_PER_CLEAR_PIXEL   1U
+#define SIM_CYCLES_PER_COMPOSE_PIXEL 5U
+#define SIM_CYCLES_PER_COMPOSE_ROW   4U
+#define SIM_CYCLES_PER_COMPOSE_RECT  24U
+
+#define SIM_PANEL_W 240
+#define SIM_PANEL_H 320
+
+typedef struct
+{
+    uint64_t transactions;  // CS low -> high
+    uint64_t cmd_bytes;     // bytes sent with DC low
+    uint64_t param_bytes;   // DC high bytes that are command parameters
+    uint64_t pixel_bytes;   // DC high bytes that follow a memory write
+    uint64_t bus_cycles;    // cycles the SPI line was busy
+    uint64_t busy_waits;    // BSY polls that found a byte still shifting
+    uint64_t busy_cycles;   // cycles spent in them
+    uint64_t early_lines;   // CS/DC changes while a byte was still shifting
+    uint64_t overlaps;      // CPU-side SPI sends while interrupt-sent bytes
+                            // were still on the wire
+} sim_stats_t;
+
+/**
+ * @brief Clears the panel, counters and simulated clock.
+ */
+void sim_reset(void);
+
+/**
+ * @brief Returns the simulated cycle count since sim_reset().
+ */
+uint64_t sim_cycles(void);
+
+/**
+ * @brief Advances the simulated clock.
+ *
+ * @param cycles Number of core cycles to add.
+ */
+void sim_advance(uint64_t cycles);
+
+/**
+ * @brief Returns the host's monotonic clock in nanoseconds.
+ *
+ * For timing pure computation, which the simulated clock does not see.
+ */
+uint64_t sim_host_ns(void);
+
+/**
+ * @brief Changes the simulated SPI speed.
+ *
+ * @param cycles Core cycles per byte; SIM_CYCLES_PER_SPI_BYTE by default.
+ */
+void sim_set_spi_cycles_per_byte(uint32_t cycles);
+
+/**
+ * @brief Returns the bus counters since sim_reset() or sim_clear_stats().
+ */
+const sim_stats_t *sim_stats(void);
+
+/**
+ * @brief Zeros the bus counters, keeping the panel contents and clock.
+ */
+void sim_clear_stats(void);
+
+/**
+ * @brief Reads a pixel as the viewer sees it, in the current rotation
+ *        and with the current hardware scroll applied.
+ *
+ * @param x X-coordinate.
+ * @param y Y-coordinate.
+ * @return RGB565 color, or 0 outside the screen.
+ */
+uint16_t sim_read_pixel(uint16_t x, uint16_t y);
+
+/**
+ * @brief Returns the screen size in the current rotation.
+ */
+void sim_screen_size(uint16_t *width, uint16_t *height);
+
+/**
+ * @brief Writes the visible screen as a binary PPM image.
+ *
+ * @param path Output file.
+ * @return true on success.
+ */
+bool sim_write_ppm(const char *path);
+
+// ---------------------------------------------------------------------------
+// Interrupt-driven SPI (spiq.h)
+//
+// Bytes and CS/DC changes made from the modelled SPI2 interrupt reach the
+// panel at once, but each byte keeps the bus busy for its wire time after
+// whatever is already on it, without holding up the CPU. The CPU cost of
+// queueing and of the interrupts is left to the caller
+// (SIM_CYCLES_PER_SPI_PUT, SIM_CYCLES_PER_SPI_IRQ).
+
+/**
+ * @brief Sends bytes from the SPI interrupt.
+ */
+void sim_spi_async(const uint8_t *data, uint32_t len);
+
+/**
+ * @brief Changes CS or DC from the SPI interrupt, once the bytes before it
+ *        are off the wire.
+ */
+void sim_pin_async(uint8_t pin, uint8_t value);
+
+/**
+ * @brief Returns the cycle at which the last byte sent is off the wire.
+ */
+uint64_t sim_spi_idle_at(void);
+
+// ---------------------------------------------------------------------------
+// Simulated UART (uart.c)
+//
+// Bytes go out over a file descriptor, typically one end of a socketpair
+// or a pseudo-terminal, so two host processes can talk to each other.
+// Outgoing bytes can be held back for a number of simulated cycles to
+// model link latency.
+
+/**
+ * @brief Connects the UART to a file descriptor and makes it non-blocking.
+ *
+ * @param fd Open descriptor, or -1 to disconnect.
+ */
+void sim_uart_attach(int fd);
+
+/**
+ * @brief Holds every written byte back until the simulated clock has
+ *        advanced this many cycles past the write.
+ */
+void sim_uart_set_latency(uint64_t cycles);
+
+/**
+ * @brief Queues bytes for sending.
+ *
+ * @return Number of bytes accepted.
+ */
+uint32_t sim_uart_write(const uint8_t *data, uint32_t len);
+
+/**
+ * @brief Reads the bytes that have arrived, without blocking.
+ *
+ * @return Number of bytes read.
+ */
+uint32_t sim_uart_read(uint8_t *data, uint32_t max);
+
+/**
+ * @brief Waits for incoming bytes for up to the given number of cycles of
+ *        real time, then advances the simulated clock by that amount.
+ */
+void sim_uart_wait(uint32_t cycles);
+
+/**
+ * @brief Sends everything still held back, ignoring the latency.
+ */
+void sim_uart_flush(void);
+
+// ---------------------------------------------------------------------------
+// Simulated ST-LINK virtual COM port (vcp.c)
+//
+// Write-only. The mirror stream (mirror.h) paces itself against the
+// simulated clock and hands its bytes over as the UART would send them.
+
+/**
+ * @brief Directs the port to a file descriptor.
+ *
+ * @param fd Open descriptor, or -1 to discard everything.
+ */
+void sim_vcp_attach(int fd);
+
+/**
+ * @brief Writes bytes out, blocking until they are all taken.
+ */
+void sim_vcp_write(const uint8_t *data, uint32_t len);
+
+#endif
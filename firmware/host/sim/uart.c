@@ -0,0 +1,124 @@
+// Simulated UART over a file descriptor.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sim.h"
+
+#define HOLD_CHUNKS 1024
+#define CHUNK_BYTES 32
+
+typedef struct
+{
+    uint64_t release;       // simulated cycle the bytes may leave at
+    uint8_t len;
+    uint8_t data[CHUNK_BYTES];
+} held_chunk_t;
+
+static int g_fd = -1;
+static uint64_t g_latency;
+static held_chunk_t g_held[HOLD_CHUNKS];
+static uint32_t g_head;     // oldest held chunk
+static uint32_t g_count;
+
+
+static void send_all(const uint8_t *data, uint32_t len)
+{
+    while(len)
+    {
+        ssize_t n = write(g_fd, data, len);
+        if(n < 0)
+        {
+            if(errno == EAGAIN || errno == EINTR)
+            {
+                struct pollfd p = { .fd = g_fd, .events = POLLOUT };
+                poll(&p, 1, 10);
+                continue;
+            }
+            return; // peer gone; drop
+        }
+        data += n;
+        len -= (uint32_t)n;
+    }
+}
+
+static void pump(bool all)
+{
+    while(g_count && (all || g_held[g_head].release <= sim_cycles()))
+    {
+        send_all(g_held[g_head].data, g_held[g_head].len);
+        g_head = (g_head + 1U) % HOLD_CHUNKS;
+        --g_count;
+    }
+}
+
+void sim_uart_attach(int fd)
+{
+    g_fd = fd;
+    g_head = 0;
+    g_count = 0;
+
+    if(fd >= 0) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+void sim_uart_set_latency(uint64_t cycles)
+{
+    g_latency = cycles;
+}
+
+uint32_t sim_uart_write(const uint8_t *data, uint32_t len)
+{
+    uint32_t done = 0;
+
+    if(g_fd < 0) return 0;
+
+    while(done < len)
+    {
+        if(g_count == HOLD_CHUNKS) pump(true);
+
+        held_chunk_t *c = &g_held[(g_head + g_count) % HOLD_CHUNKS];
+        uint32_t n = len - done < CHUNK_BYTES ? len - done : CHUNK_BYTES;
+
+        c->release = sim_cycles() + g_latency;
+        c->len = (uint8_t)n;
+        memcpy(c->data, data + done, n);
+        ++g_count;
+        done += n;
+    }
+
+    pump(false);
+    return done;
+}
+
+uint32_t sim_uart_read(uint8_t *data, uint32_t max)
+{
+    if(g_fd < 0) return 0;
+
+    pump(false);
+
+    ssize_t n = read(g_fd, data, max);
+    return n > 0 ? (uint32_t)n : 0;
+}
+
+void sim_uart_wait(uint32_t cycles)
+{
+    if(g_fd >= 0)
+    {
+        struct pollfd p = { .fd = g_fd, .events = POLLIN };
+        int ms = (int)(cycles / (SIM_CPU_HZ / 1000U));
+        poll(&p, 1, ms > 0 ? ms : 1);
+    }
+
+    sim_advance(cycles);
+    pump(false);
+}
+
+void sim_uart_flush(void)
+{
+    if(g_fd >= 0) pump(true);
+}
@@ -0,0 +1,31 @@
+// Simulated ST-LINK virtual COM port.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <errno.h>
+#include <unistd.h>
+
+#include "sim.h"
+
+static int g_fd = -1;
+
+
+void sim_vcp_attach(int fd)
+{
+    g_fd = fd;
+}
+
+void sim_vcp_write(const uint8_t *data, uint32_t len)
+{
+    while(g_fd >= 0 && len)
+    {
+        ssize_t n = write(g_fd, data, len);
+        if(n < 0)
+        {
+            if(errno == EINTR) continue;
+            return; // reader gone; drop
+        }
+        data += n;
+        len -= (uint32_t)n;
+    }
+}
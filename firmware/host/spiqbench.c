@@ -0,0 +1,161 @@
+// SPI queue measurement.
+//
+// Draws the same game frames twice at each of several SPI speeds: once
+// blocking, with every transfer sent from the CPU and BSY polled before
+// each CS or DC change, and once with commands and sprites going through
+// the interrupt-driven queue (spiq.h). Reports the CPU cycles each frame
+// keeps busy both ways and the difference, which is what the queue hands
+// back to the game, and checks that both runs leave the same screen, that
+// no CS or DC change cut into a byte and that nothing drove the bus while
+// queued bytes were still on the wire.
+//
+// Frames start every FRAME_MS as in the game, and the time left over
+// stands for the sleep in power_frame_idle(): queued bytes drain during
+// it. The simulated clock moves for driver calls, bus waits and, with
+// the queue, SIM_CYCLES_PER_SPI_PUT per entry and SIM_CYCLES_PER_SPI_IRQ
+// per interrupt.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "f446re.h"
+#include "ili9341.h"
+#include "perf.h"
+#include "pong.h"
+#include "spiq.h"
+
+#define FRAMES      600
+#define MAX_SIDE    320
+
+typedef struct
+{
+    uint64_t cycles;        // CPU cycles busy over all frames
+    uint32_t bytes;         // bus bytes
+    sim_stats_t bus;
+    spiq_stats_t queue;
+} run_t;
+
+static const uint32_t g_speeds[] = { 16, 32, 64, 128 };
+
+static uint16_t g_view[MAX_SIDE * MAX_SIDE];
+
+
+static void snapshot(void)
+{
+    uint16_t w, h;
+    sim_screen_size(&w, &h);
+    for(uint16_t y = 0; y < h; ++y)
+    {
+        for(uint16_t x = 0; x < w; ++x) g_view[y * MAX_SIDE + x] = sim_read_pixel(x, y);
+    }
+}
+
+static uint32_t differ(void)
+{
+    uint16_t w, h;
+    uint32_t bad = 0;
+    sim_screen_size(&w, &h);
+    for(uint16_t y = 0; y < h; ++y)
+    {
+        for(uint16_t x = 0; x < w; ++x) bad += g_view[y * MAX_SIDE + x] != sim_read_pixel(x, y);
+    }
+    return bad;
+}
+
+static void run(uint32_t byte_cycles, bool queued, run_t *out)
+{
+    sim_reset();
+    pong_init();
+    sim_set_spi_cycles_per_byte(byte_cycles);
+    if(queued) spiq_init();
+
+    pong_state_t state;
+    pong_vel_t vel;
+    pong_input_t input;
+    pong_reset(&state, &vel);
+    pong_draw_field(&state);
+    spiq_fence();
+
+    sim_clear_stats();
+    uint32_t bytes = ili9341_get_tx_bytes();
+    uint64_t busy = 0;
+
+    for(uint32_t n = 0; n < FRAMES; ++n)
+    {
+        uint64_t start = sim_cycles();
+
+        pong_state_t prev = state;
+        pong_follow(&state, &input);
+        pong_step(&state, &vel, &input);
+        pong_draw_frame(&prev, &state);
+
+        busy += sim_cycles() - start;
+        if(sim_cycles() < start + PERF_MS_TO_CYCLES(FRAME_MS))
+        {
+            sim_advance(start + PERF_MS_TO_CYCLES(FRAME_MS) - sim_cycles());
+        }
+    }
+
+    // The last frame's bytes still count
+    uint64_t start = sim_cycles();
+    spiq_fence();
+    busy += sim_cycles() - start;
+
+    out->cycles = busy;
+    out->bytes = ili9341_get_tx_bytes() - bytes;
+    out->bus = *sim_stats();
+    out->queue = *spiq_get_stats();
+
+    if(queued) spiq_stop();
+}
+
+int main(void)
+{
+    uint32_t failures = 0;
+
+    printf("%u frames of the game, CPU cycles busy per frame\n\n", FRAMES);
+    printf("cycles/byte blocking   queued  reclaimed    irqs  rxne  in isr  waiting\n");
+
+    for(size_t i = 0; i < sizeof(g_speeds) / sizeof(g_speeds[0]); ++i)
+    {
+        run_t blocking, queued;
+
+        run(g_speeds[i], false, &blocking);
+        snapshot();
+        run(g_speeds[i], true, &queued);
+
+        uint32_t bad = differ();
+        uint64_t early = blocking.bus.early_lines + queued.bus.early_lines;
+        if(bad || early || queued.bus.overlaps || queued.bytes != blocking.bytes)
+        {
+            printf("  %u cycles/byte: %u pixels differ, %llu early line changes, %llu overlaps, "
+                   "%u against %u bytes\n",
+                   g_speeds[i], bad, (unsigned long long)early,
+                   (unsigned long long)queued.bus.overlaps, queued.bytes, blocking.bytes);
+            failures++;
+        }
+
+        printf("%11u %8.0f %8.0f %+10.0f %7.0f %5.1f %7.0f %8.0f\n",
+               g_speeds[i],
+               (double)blocking.cycles / FRAMES,
+               (double)queued.cycles / FRAMES,
+               ((double)blocking.cycles - (double)queued.cycles) / FRAMES,
+               (double)queued.queue.irqs / FRAMES,
+               (double)queued.queue.idle_irqs / FRAMES,
+               (double)queued.queue.isr_cycles / FRAMES,
+               (double)queued.queue.wait_cycles / FRAMES);
+
+        if(i + 1 == sizeof(g_speeds) / sizeof(g_speeds[0]))
+        {
+            printf("\nqueued     %.0f of %.0f bytes/frame, %.0f markers/frame, %.1f fences/frame, ring peak %u of %u\n",
+                   (double)queued.queue.bytes / FRAMES, (double)queued.bytes / FRAMES,
+                   (double)queued.queue.markers / FRAMES, (double)queued.queue.fences / FRAMES,
+                   queued.queue.ring_peak, SPIQ_RING);
+        }
+    }
+
+    printf("check      %s\n", failures ? "FAIL" : "ok");
+
+    return failures ? 2 : 0;
+}
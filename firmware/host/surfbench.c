@@ -0,0 +1,200 @@
+// Indexed surface check and benchmark.
+//
+// Draws random rectangles, spans and glyphs into a 4 bpp surface and into
+// a plain RGB565 reference, flushes regions at odd and even offsets and
+// compares the simulated panel against the reference. Then times the
+// index expansion loop and compares the bus cost of redrawing the screen
+// in strips through the same amount of RAM as RGB565 and as 4 bpp.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "f446re.h"
+#include "ili9341.h"
+#include "surface.h"
+
+#define SCREEN_W    320
+#define SCREEN_H    240
+#define BUDGET      4096        // bytes of RAM for the strip buffer
+
+static const uint16_t g_colors[SURFACE_PALETTE_SIZE] = {
+    COLOR_BLACK, COLOR_WHITE, COLOR_RED, COLOR_BLUE,
+    COLOR_YELLOW, COLOR_CYAN, COLOR_MAGENTA, COLOR_GRAY,
+    COLOR_ORANGE, COLOR_PURPLE, 0x07E0, 0x0410,
+    0x8000, 0x0010, 0x4208, 0xC618
+};
+
+static const uint8_t g_glyph[7] = { 0x38, 0x44, 0x4C, 0x54, 0x64, 0x44, 0x38 }; // 5x7 zero
+
+static surface_palette_t g_palette;
+static uint8_t g_pixels[SURFACE_BYTES(SCREEN_W, SCREEN_H)];
+static uint16_t g_ref[SCREEN_H][SCREEN_W];
+static uint8_t g_strip[BUDGET];
+static uint32_t g_rng = 88172645UL;
+
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static int32_t rand_range(int32_t lo, int32_t hi)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return lo + (int32_t)(g_rng % (uint32_t)(hi - lo + 1));
+}
+
+static void ref_rect(int32_t x, int32_t y, int32_t w, int32_t h, uint8_t index)
+{
+    for(int32_t yy = y; yy < y + h; ++yy)
+    {
+        for(int32_t xx = x; xx < x + w; ++xx)
+        {
+            if(xx >= 0 && xx < SCREEN_W && yy >= 0 && yy < SCREEN_H) g_ref[yy][xx] = g_colors[index];
+        }
+    }
+}
+
+static void ref_glyph(int32_t x, int32_t y, uint8_t index)
+{
+    for(int32_t gy = 0; gy < 7; ++gy)
+    {
+        for(int32_t gx = 0; gx < 5; ++gx)
+        {
+            if(g_glyph[gy] & (0x80U >> gx)) ref_rect(x + gx, y + gy, 1, 1, index);
+        }
+    }
+}
+
+static uint32_t check(surface_t *s)
+{
+    surface_clear(s, 0);
+    ref_rect(0, 0, SCREEN_W, SCREEN_H, 0);
+
+    for(uint32_t n = 0; n < 2000; ++n)
+    {
+        int16_t x = (int16_t)rand_range(-20, SCREEN_W);
+        int16_t y = (int16_t)rand_range(-20, SCREEN_H);
+        int16_t w = (int16_t)rand_range(1, 60);
+        int16_t h = (int16_t)rand_range(1, 40);
+        uint8_t index = (uint8_t)rand_range(0, SURFACE_PALETTE_SIZE - 1);
+
+        switch(n % 3)
+        {
+            case 0: surface_fill_rect(s, x, y, w, h, index); ref_rect(x, y, w, h, index); break;
+            case 1: surface_draw_span(s, x, y, w, index);    ref_rect(x, y, w, 1, index); break;
+            default: surface_draw_glyph(s, x, y, g_glyph, 5, 7, index); ref_glyph(x, y, index); break;
+        }
+    }
+
+    // Flush in random tiles at odd and even offsets until every pixel has been sent
+    for(uint16_t y = 0; y < SCREEN_H; y = (uint16_t)(y + 37))
+    {
+        for(uint16_t x = 0; x < SCREEN_W; )
+        {
+            uint16_t w = (uint16_t)rand_range(1, 91);
+            surface_flush(s, x, y, w, 37, x, y);
+            x = (uint16_t)(x + w);
+        }
+    }
+
+    uint32_t bad = 0;
+    for(uint16_t y = 0; y < SCREEN_H; ++y)
+    {
+        for(uint16_t x = 0; x < SCREEN_W; ++x)
+        {
+            if(sim_read_pixel(x, y) != g_ref[y][x]) ++bad;
+        }
+    }
+    return bad;
+}
+
+static double time_expand(const surface_t *s, uint16_t x0)
+{
+    uint8_t out[SCREEN_W * 2];
+    const uint16_t count = (uint16_t)(SCREEN_W - x0);
+    const uint32_t rounds = 50;
+    volatile uint8_t sink = 0;
+
+    double t0 = now_ns();
+    for(uint32_t r = 0; r < rounds; ++r)
+    {
+        for(uint16_t y = 0; y < SCREEN_H; ++y)
+        {
+            surface_expand(s, x0, y, count, out);
+            sink = (uint8_t)(sink + out[0]);
+        }
+    }
+    (void)sink;
+
+    return (now_ns() - t0) / ((double)rounds * SCREEN_H * count);
+}
+
+static void strips(const char *name, bool indexed, surface_t *s)
+{
+    const uint16_t rows = indexed ? (uint16_t)(BUDGET / ((SCREEN_W + 1) / 2))
+                                  : (uint16_t)(BUDGET / (SCREEN_W * 2));
+    uint32_t windows = 0;
+
+    sim_clear_stats();
+    for(uint16_t y = 0; y < SCREEN_H; y = (uint16_t)(y + rows))
+    {
+        uint16_t h = (uint16_t)(SCREEN_H - y < rows ? SCREEN_H - y : rows);
+
+        if(indexed)
+        {
+            surface_flush(s, 0, y, SCREEN_W, h, 0, y);
+        }
+        else
+        {
+            // The RGB565 strip is composed straight into wire order
+            for(uint16_t r = 0; r < h; ++r) surface_expand(s, 0, (uint16_t)(y + r), SCREEN_W, &g_strip[r * SCREEN_W * 2]);
+            ili9341_draw_buffer(0, y, SCREEN_W, h, g_strip);
+        }
+        ++windows;
+    }
+
+    const sim_stats_t *st = sim_stats();
+    printf("%-8s %3u rows/strip %3u windows %7llu cmd+param bytes %8llu bus cycles\n",
+           name, rows, windows,
+           (unsigned long long)(st->cmd_bytes + st->param_bytes),
+           (unsigned long long)st->bus_cycles);
+}
+
+int main(void)
+{
+    surface_t s;
+
+    sim_reset();
+    ili9341_config_t config = {
+        .invert_on_init = false,
+        .pixel_format = ILI9341_PIXEL_FORMAT_RGB565,
+        .rotation = ILI9341_ROT_90
+    };
+    ili9341_init(&config);
+
+    surface_set_palette(&g_palette, g_colors);
+    surface_init(&s, g_pixels, SCREEN_W, SCREEN_H, &g_palette);
+
+    uint32_t bad = check(&s);
+
+    printf("memory   %u bytes for %ux%u (RGB565: %u)\n",
+           (unsigned)sizeof(g_pixels), SCREEN_W, SCREEN_H, SCREEN_W * SCREEN_H * 2U);
+    time_expand(&s, 0); // warm up
+    printf("expand   %.2f ns/pixel aligned, %.2f ns/pixel odd start (host)\n",
+           time_expand(&s, 0), time_expand(&s, 1));
+    printf("strips   full screen through a %u byte buffer\n", BUDGET);
+    strips("rgb565", false, &s);
+    strips("4bpp", true, &s);
+    printf("check    %s (%u bad pixels)\n", bad ? "FAIL" : "ok", bad);
+
+    return bad ? 2 : 0;
+}
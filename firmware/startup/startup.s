@@ -10,6 +10,7 @@
     .extern _edata
     .extern _sidata
     .extern _estack
+    .extern _end
 
 /* --------------------------------------------------------------------------
  * Vector table
@@ -133,7 +134,7 @@ vectors:
     .word   FMPI2C1_ER_Handler
 
 /* --------------------------------------------------------------------------
- * Reset_Handler: zero .bss, copy .data, call main, then loop
+ * Reset_Handler: zero .bss, copy .data, paint the stack, call main, then loop
  * -------------------------------------------------------------------------- */
     .text
     .align  2
@@ -166,7 +167,18 @@ Reset_Handler:
     str     r3, [r0], #4
     b       4b
 
-6:  /* Call main(); */
+6:  /* Paint the free RAM under the stack with ARENA_STACK_PAINT
+       (app/display/arena.h); nothing is on the stack yet */
+    ldr     r0, =_end
+    ldr     r1, =_estack
+    ldr     r2, =0xC5C5C5C5
+8:
+    cmp     r0, r1
+    bcs     9f
+    str     r2, [r0], #4
+    b       8b
+
+9:  /* Call main(); */
     bl      main
 
     /* If main returns, loop forever */